@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "xswap.h"
+
+/* Microbenchmark of the edge membership backends. For each node range and
+ density, a power-law network is loaded into every backend that fits in
+ `--max-malloc`, then `contains` is timed on existing edges (hit), absent
+ pairs (miss) and uniformly random pairs (random), and `remove` and `add` on
+ existing edges. Results are written as JSON with nanoseconds and hardware
+ cache misses per operation, and bytes per edge of each backend. */
+
+static const char USAGE[] =
+    "Usage: bitset_benchmark [options]\n"
+    "\n"
+    "Options:\n"
+    "  --max-ids LIST     comma-separated largest node ids (default: 1000,10000,30000)\n"
+    "  --densities LIST   comma-separated fractions of node pairs that are edges\n"
+    "                     (default: 0.0001,0.001,0.01)\n"
+    "  --ops N            operations timed per measurement (default: 1000000)\n"
+    "  --max-malloc B     largest uncompressed bitset to benchmark (default: 4000000000)\n"
+    "  --seed S           random seed (default: 0)\n"
+    "  --output PATH      JSON output path (default: stdout)\n";
+
+struct Measurement {
+    double ns_per_op;
+    double cache_misses_per_op;
+};
+
+// Time `operation(i)` for each of `num_ops` operations
+template <typename Operation>
+static Measurement measure(size_t num_ops, HardwareCounter &counter, Operation operation) {
+    counter.start();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_ops; i++) {
+        operation(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    long long misses = counter.stop();
+    Measurement result;
+    result.ns_per_op = elapsed.count() / num_ops;
+    result.cache_misses_per_op = misses < 0 ? -1 : (double)misses / num_ops;
+    return result;
+}
+
+static std::vector<double> parse_list(const std::string &value) {
+    std::vector<double> values;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(atof(item.c_str()));
+    }
+    return values;
+}
+
+struct Config {
+    std::vector<double> max_ids = {1000, 10000, 30000};
+    std::vector<double> densities = {0.0001, 0.001, 0.01};
+    size_t num_ops = 1000000;
+    unsigned long long max_malloc = 4000000000ULL;
+    unsigned long long seed = 0;
+    std::string output_path;
+};
+
+// Network and queries shared by the backends
+struct Workload {
+    std::vector<int> edges;
+    std::vector<int*> edge_ptrs;
+    std::vector<int> hits, misses, randoms;
+};
+
+static Workload make_workload(int max_id, double density, const Config &config) {
+    Workload workload;
+    double possible = (double)(max_id + 1) * (max_id + 1);
+    size_t num_edges = std::max((size_t)1, (size_t)(density * possible));
+    generate_power_law_edges(max_id + 1, max_id + 1, num_edges, 2.5, true, true,
+                             config.seed, 1, workload.edges);
+    size_t num_generated = workload.edges.size() / 2;
+    for (size_t i = 0; i < num_generated; i++) {
+        workload.edge_ptrs.push_back(&workload.edges[2 * i]);
+    }
+
+    // Membership of generated edges, to draw misses
+    std::vector<unsigned long long> keys(num_generated);
+    for (size_t i = 0; i < num_generated; i++) {
+        keys[i] = ((unsigned long long)workload.edges[2 * i] << 32) | workload.edges[2 * i + 1];
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::mt19937_64 rng(config.seed + 1);
+    std::uniform_int_distribution<int> node(0, max_id);
+    std::uniform_int_distribution<size_t> edge(0, num_generated - 1);
+    for (size_t i = 0; i < config.num_ops; i++) {
+        size_t e = edge(rng);
+        workload.hits.push_back(workload.edges[2 * e]);
+        workload.hits.push_back(workload.edges[2 * e + 1]);
+
+        int source = node(rng), target = node(rng);
+        workload.randoms.push_back(source);
+        workload.randoms.push_back(target);
+
+        do {
+            source = node(rng);
+            target = node(rng);
+        } while (std::binary_search(keys.begin(), keys.end(),
+                                    ((unsigned long long)source << 32) | target));
+        workload.misses.push_back(source);
+        workload.misses.push_back(target);
+    }
+    return workload;
+}
+
+static void write_result(std::ostream &output, bool &first, const char *backend, int max_id,
+                         double density, size_t num_edges, size_t num_bytes,
+                         double build_ns_per_edge, const char *operation,
+                         const char *pattern, Measurement measurement) {
+    output << (first ? "\n" : ",\n") << "    {\"backend\": \"" << backend << "\""
+           << ", \"max_id\": " << max_id << ", \"density\": " << density
+           << ", \"num_edges\": " << num_edges
+           << ", \"bytes_per_edge\": " << (double)num_bytes / num_edges
+           << ", \"build_ns_per_edge\": " << build_ns_per_edge
+           << ", \"operation\": \"" << operation << "\", \"pattern\": \"" << pattern << "\""
+           << ", \"ns_per_op\": " << measurement.ns_per_op << ", \"cache_misses_per_op\": ";
+    if (measurement.cache_misses_per_op < 0)
+        output << "null}";
+    else
+        output << measurement.cache_misses_per_op << "}";
+    first = false;
+}
+
+static void free_backend(UncompressedBitSet &set) { set.free_array(); }
+static void free_backend(RoaringBitSet &) {}
+
+/* Time the operations of one backend, where `make` builds it from `edges`.
+ Queries and removals are spread over the whole network, and each removed
+ edge is added back so the set ends as it started. */
+template <typename Backend, typename Make>
+static void benchmark_backend(std::ostream &output, bool &first, const char *backend_name,
+                              int max_id, double density, const Workload &workload,
+                              const Config &config, HardwareCounter &counter, Make make) {
+    Edges edges;
+    edges.edge_array = const_cast<int**>(workload.edge_ptrs.data());
+    edges.num_edges = (int)workload.edge_ptrs.size();
+    edges.max_id = max_id;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Backend set = make(edges);
+    std::chrono::duration<double, std::nano> build = std::chrono::steady_clock::now() - start;
+    double build_ns_per_edge = build.count() / edges.num_edges;
+    size_t num_bytes = set.size_in_bytes();
+
+    const char* patterns[3] = {"hit", "miss", "random"};
+    const std::vector<int>* queries[3] = {&workload.hits, &workload.misses, &workload.randoms};
+    volatile size_t found = 0;
+    for (int p = 0; p < 3; p++) {
+        int* pairs = const_cast<int*>(queries[p]->data());
+        size_t count = 0;
+        Measurement measurement = measure(config.num_ops, counter, [&](size_t i) {
+            count += set.contains(pairs + 2 * i);
+        });
+        found = found + count;
+        write_result(output, first, backend_name, max_id, density, edges.num_edges, num_bytes,
+                     build_ns_per_edge, "contains", patterns[p], measurement);
+    }
+
+    // Remove and re-add distinct edges in a random order
+    std::vector<int*> order(workload.edge_ptrs);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(config.seed + 2));
+    order.resize(std::min(order.size(), config.num_ops));
+    Measurement removal = measure(order.size(), counter, [&](size_t i) {
+        set.remove(order[i]);
+    });
+    Measurement addition = measure(order.size(), counter, [&](size_t i) {
+        set.add(order[i]);
+    });
+    write_result(output, first, backend_name, max_id, density, edges.num_edges, num_bytes,
+                 build_ns_per_edge, "remove", "hit", removal);
+    write_result(output, first, backend_name, max_id, density, edges.num_edges, num_bytes,
+                 build_ns_per_edge, "add", "miss", addition);
+    free_backend(set);
+}
+
+int main(int argc, char **argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << USAGE;
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "bitset_benchmark: missing value for " << arg << "\n\n" << USAGE;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--max-ids")
+            config.max_ids = parse_list(value);
+        else if (arg == "--densities")
+            config.densities = parse_list(value);
+        else if (arg == "--ops")
+            config.num_ops = strtoull(value.c_str(), NULL, 10);
+        else if (arg == "--max-malloc")
+            config.max_malloc = strtoull(value.c_str(), NULL, 10);
+        else if (arg == "--seed")
+            config.seed = strtoull(value.c_str(), NULL, 10);
+        else if (arg == "--output")
+            config.output_path = value;
+        else {
+            std::cerr << "bitset_benchmark: unknown option " << arg << "\n\n" << USAGE;
+            return 2;
+        }
+    }
+    if (config.num_ops == 0) {
+        std::cerr << "bitset_benchmark: --ops must be positive\n";
+        return 2;
+    }
+
+    std::ofstream output_file;
+    if (!config.output_path.empty()) {
+        output_file.open(config.output_path.c_str());
+        if (!output_file) {
+            std::cerr << "bitset_benchmark: could not open " << config.output_path << "\n";
+            return 1;
+        }
+    }
+    std::ostream &output = config.output_path.empty() ? std::cout : output_file;
+
+    HardwareCounter counter(CACHE_MISSES);
+    output << "{\n  \"benchmark\": \"bitset\",\n  \"ops\": " << config.num_ops
+           << ",\n  \"seed\": " << config.seed
+           << ",\n  \"cache_misses_available\": " << (counter.available() ? "true" : "false")
+           << ",\n  \"results\": [";
+    bool first = true;
+    try {
+        for (size_t m = 0; m < config.max_ids.size(); m++) {
+            int max_id = (int)config.max_ids[m];
+            for (size_t d = 0; d < config.densities.size(); d++) {
+                double density = config.densities[d];
+                Workload workload = make_workload(max_id, density, config);
+                int max_pair[2] = {max_id, max_id};
+                if (cantor_pair(max_pair) / CHAR_BITS < config.max_malloc) {
+                    benchmark_backend<UncompressedBitSet>(
+                        output, first, "uncompressed", max_id, density, workload, config,
+                        counter, [&](Edges edges) {
+                            return UncompressedBitSet(edges, config.max_malloc);
+                        });
+                }
+                benchmark_backend<RoaringBitSet>(
+                    output, first, "roaring", max_id, density, workload, config, counter,
+                    [](Edges edges) { return RoaringBitSet(edges); });
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "bitset_benchmark: " << e.what() << "\n";
+        return 1;
+    }
+    output << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,241 @@
+"""
+End-to-end performance regression suite for XSwap.
+
+Runs permutations and priors on fixed synthetic networks from
+`xswap.network_formats.generate_power_law_edges`, each case in its own
+process so that peak memory is measured per case, and compares the results
+with a stored baseline:
+
+    python benchmarks/run_benchmarks.py                   # compare with baseline.json
+    python benchmarks/run_benchmarks.py --update-baseline # record a new baseline
+    python benchmarks/run_benchmarks.py --cases small-undirected,priors-small
+
+The exit status is 1 if any metric regressed by more than the tolerance.
+Timings depend on the machine, so baselines should be recorded on the machine
+that runs the comparison.
+"""
+import argparse
+import json
+import os
+import platform
+import resource
+import subprocess
+import sys
+import time
+import warnings
+
+import numpy
+
+import xswap
+
+BASELINE_PATH = os.path.join(os.path.dirname(os.path.realpath(__file__)), 'baseline.json')
+
+# Permutation flags of each kind of network, as recommended in README.md
+FLAGS = {
+    'undirected': {'allow_self_loops': False, 'allow_antiparallel': False},
+    'undirected-loops': {'allow_self_loops': True, 'allow_antiparallel': False},
+    'directed': {'allow_self_loops': False, 'allow_antiparallel': True},
+    'bipartite': {'allow_self_loops': True, 'allow_antiparallel': True},
+}
+
+# Number of edges before erasure and number of nodes of each size
+SIZES = {
+    'small': (10000, 1000),
+    'medium': (200000, 20000),
+    'large': (2000000, 40000),
+}
+
+
+def _permutation_cases():
+    cases = dict()
+    for size in SIZES:
+        for kind in FLAGS:
+            cases['{}-{}'.format(size, kind)] = {
+                'type': 'permute', 'size': size, 'kind': kind, 'max_malloc': 4000000000}
+    # Roaring bitset, used when the uncompressed bitset exceeds max_malloc
+    cases['medium-undirected-roaring'] = {
+        'type': 'permute', 'size': 'medium', 'kind': 'undirected', 'max_malloc': 1}
+    return cases
+
+
+CASES = _permutation_cases()
+CASES['priors-small'] = {'type': 'priors', 'size': (10000, 1000), 'n_permutations': 20}
+CASES['priors-medium'] = {'type': 'priors', 'size': (40000, 2000), 'n_permutations': 5}
+
+# Whether larger values of each metric are better
+METRICS = {
+    'swaps_per_second': True,
+    'setup_seconds': False,
+    'conversion_seconds': False,
+    'prior_seconds': False,
+    'peak_rss_mb': False,
+}
+
+
+def _network(size, kind):
+    num_edges, num_nodes = SIZES[size] if isinstance(size, str) else size
+    return xswap.network_formats.generate_power_law_edges(
+        num_edges, (num_nodes, num_nodes), bipartite=(kind == 'bipartite'),
+        directed=(kind in ('directed', 'bipartite')), seed=0, as_array=True)
+
+
+def _best_time(function, repeats):
+    """
+    Smallest wall time of `repeats` calls of `function`
+    """
+    best = float('inf')
+    for _ in range(repeats):
+        start = time.perf_counter()
+        function()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def _run_permute_case(case, repeats):
+    """
+    Swap rate from permutations with and without swaps of an int32 array, so
+    that bitset construction and copying is excluded. Setup is the time of a
+    permutation without swaps, and conversion the extra time of the same call
+    with a list of tuples, which is converted to and from Python objects.
+    """
+    edges = _network(case['size'], case['kind'])
+    flags = dict(FLAGS[case['kind']], max_malloc=case['max_malloc'])
+    multiplier = 1
+    setup = _best_time(lambda: xswap.permute_edge_list(edges, multiplier=0, **flags), repeats)
+    total = _best_time(
+        lambda: xswap.permute_edge_list(edges, multiplier=multiplier, **flags), repeats)
+    edge_list = list(map(tuple, edges.tolist()))
+    list_setup = _best_time(
+        lambda: xswap.permute_edge_list(edge_list, multiplier=0, **flags), repeats)
+    return {
+        'num_edges': len(edges),
+        'swaps_per_second': int(multiplier * len(edges)) / max(total - setup, 1e-9),
+        'setup_seconds': setup,
+        'conversion_seconds': max(list_setup - setup, 0.0),
+    }
+
+
+def _run_priors_case(case, repeats):
+    num_edges, num_nodes = case['size']
+    edges = xswap.network_formats.generate_power_law_edges(
+        num_edges, (num_nodes, num_nodes), seed=0, as_array=True)
+    prior_seconds = _best_time(lambda: xswap.prior.compute_xswap_priors(
+        edges, n_permutations=case['n_permutations'], shape=(num_nodes, num_nodes),
+        dtypes={'id': numpy.uint16, 'degree': numpy.uint16, 'edge': bool,
+                'xswap_prior': numpy.float32}), repeats)
+    return {'num_edges': len(edges), 'prior_seconds': prior_seconds}
+
+
+def _run_case(name, repeats):
+    """
+    Run one case in this process and return its metrics, including the peak
+    resident memory of the process
+    """
+    case = CASES[name]
+    # The Roaring case warns by design
+    warnings.simplefilter('ignore', RuntimeWarning)
+    if case['type'] == 'permute':
+        result = _run_permute_case(case, repeats)
+    else:
+        result = _run_priors_case(case, repeats)
+    max_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # ru_maxrss is in kilobytes on Linux and in bytes on macOS
+    result['peak_rss_mb'] = max_rss / (1024 ** 2 if sys.platform == 'darwin' else 1024)
+    return result
+
+
+def run_cases(names, repeats):
+    """
+    Run each case in a fresh interpreter and return `{name: metrics}`
+    """
+    results = dict()
+    for name in names:
+        output = subprocess.run(
+            [sys.executable, os.path.realpath(__file__), '--run-case', name,
+             '--repeats', str(repeats)],
+            check=True, stdout=subprocess.PIPE).stdout
+        results[name] = json.loads(output.decode())
+        print('{:28s} {}'.format(name, ', '.join(
+            '{}={:.4g}'.format(key, value) for key, value in sorted(results[name].items()))),
+            file=sys.stderr)
+    return results
+
+
+def compare(results, baseline, tolerance):
+    """
+    Return a description of each metric that is worse than its baseline by
+    more than `tolerance`, as a fraction of the baseline
+    """
+    regressions = list()
+    for name, metrics in sorted(results.items()):
+        for metric, value in sorted(metrics.items()):
+            if metric not in METRICS or metric not in baseline.get(name, {}):
+                continue
+            reference = baseline[name][metric]
+            if METRICS[metric]:
+                regressed = value < reference * (1 - tolerance)
+            else:
+                # Absolute slack keeps tiny times from flagging on noise
+                regressed = value > reference * (1 + tolerance) + 0.005
+            if regressed:
+                regressions.append('{} {}: {:.4g} against baseline {:.4g}'.format(
+                    name, metric, value, reference))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    parser.add_argument('--cases', help='comma-separated cases (default: all)')
+    parser.add_argument('--repeats', type=int, default=3,
+                        help='runs per measurement, of which the fastest is kept')
+    parser.add_argument('--tolerance', type=float, default=0.25,
+                        help='allowed fractional regression (default: 0.25)')
+    parser.add_argument('--baseline', default=BASELINE_PATH, help='baseline JSON path')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='write the results as the new baseline')
+    parser.add_argument('--output', help='also write the results as JSON to this path')
+    parser.add_argument('--list', action='store_true', help='list the cases and exit')
+    parser.add_argument('--run-case', help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.run_case:
+        print(json.dumps(_run_case(args.run_case, args.repeats)))
+        return 0
+    if args.list:
+        print('\n'.join(sorted(CASES)))
+        return 0
+
+    names = sorted(CASES) if args.cases is None else args.cases.split(',')
+    unknown = set(names) - set(CASES)
+    if unknown:
+        parser.error('unknown cases: {}'.format(', '.join(sorted(unknown))))
+    results = run_cases(names, args.repeats)
+    document = {
+        'xswap_version': xswap.__version__,
+        'machine': '{} {} ({} CPUs)'.format(
+            platform.system(), platform.machine(), os.cpu_count()),
+        'python': platform.python_version(),
+        'results': results,
+    }
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(document, f, indent=2, sort_keys=True)
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(document, f, indent=2, sort_keys=True)
+            f.write('\n')
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    regressions = compare(results, baseline['results'], args.tolerance)
+    for regression in regressions:
+        print('REGRESSION ' + regression, file=sys.stderr)
+    if not regressions:
+        print('No regressions beyond {:.0%} of the baseline.'.format(args.tolerance),
+              file=sys.stderr)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
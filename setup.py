@@ -20,8 +20,12 @@ long_description = readme_path.read_text()
 
 xswap_cpp_extension = setuptools.Extension(
     'xswap._xswap_backend',
-    sources=['xswap/src/xswap_wrapper.cpp', 'xswap/src/bitset.cpp', 'xswap/src/xswap.cpp', 'xswap/lib/roaring.c'],
-    extra_compile_args=["-std=c++11"],
+    sources=['xswap/src/xswap_wrapper.cpp', 'xswap/src/bitset.cpp', 'xswap/src/xswap.cpp',
+             'xswap/src/prior.cpp', 'xswap/src/network_formats.cpp',
+             'xswap/src/edge_io.cpp', 'xswap/src/preprocessing.cpp',
+             'xswap/lib/roaring.c'],
+    extra_compile_args=["-std=c++11", "-pthread", "-fno-math-errno"],
+    extra_link_args=["-pthread"],
 )
 
 setuptools.setup(
@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include "../xswap/src/xswap.h"
 
 void handle_eptr(std::exception_ptr eptr) {
@@ -141,9 +143,75 @@ bool test_insert_existing(UncompressedBitSet edges_set) {
     return false;
 }
 
-main(int argc, char const *argv[]) {
+bool test_reset(unsigned long long int max_malloc) {
+    int original_array[2][2] = {{0, 1}, {2, 3}};
+    int current_array[2][2] = {{0, 3}, {2, 1}};
+    int* original_ptrs[2] = {original_array[0], original_array[1]};
+    int* current_ptrs[2] = {current_array[0], current_array[1]};
+    Edges original_edges = {original_ptrs, 2, 3};
+    Edges current_edges = {current_ptrs, 2, 3};
+
+    UncompressedBitSet edges_set = UncompressedBitSet(current_edges, max_malloc);
+    edges_set.reset(current_edges, original_edges);
+    bool passed = true;
+    for (int i = 0; i < 2; i++) {
+        if (!edges_set.contains(original_edges.edge_array[i])) {
+            std::printf("Original edge missing after reset\n");
+            passed = false;
+        }
+        if (edges_set.contains(current_edges.edge_array[i])) {
+            std::printf("Permuted edge remained after reset\n");
+            passed = false;
+        }
+    }
+    edges_set.free_array();
+    return passed;
+}
+
+static std::vector<std::string> handled_warnings;
+
+static void record_warning(const char *message) {
+    handled_warnings.push_back(message);
+}
+
+bool test_warning_handler() {
+    int edge_array[2][2] = {{0, 1}, {2, 3}};
+    int* edge_ptrs[2] = {edge_array[0], edge_array[1]};
+    Edges edges = {edge_ptrs, 2, 3};
+
+    // Without room for an uncompressed bitset, the Roaring fallback warns
+    WarningHandler previous = set_warning_handler(record_warning);
+    BitSet edges_set = BitSet(edges, 0);
+    edges_set.free_array();
+
+    // Captured warnings bypass the handler until the capture ends
+    std::vector<std::string> captured;
+    {
+        WarningCapture capture(&captured);
+        edges_set = BitSet(edges, 0);
+        edges_set.free_array();
+    }
+    emit_warning("After capture");
+    set_warning_handler(previous);
+    if (handled_warnings.size() != 2 || captured.size() != 1) {
+        std::printf("Warning handler was called %d times, %d captured\n",
+                    (int)handled_warnings.size(), (int)captured.size());
+        return false;
+    }
+    const std::string roaring = "Using Roaring bitset because of the large number of edges.";
+    if (handled_warnings[0] != roaring || captured[0] != roaring
+            || handled_warnings[1] != "After capture") {
+        std::printf("Unexpected warnings: '%s', '%s', captured '%s'\n",
+                    handled_warnings[0].c_str(), handled_warnings[1].c_str(),
+                    captured[0].c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char const *argv[]) {
     unsigned long long int max_malloc = 4000000;
-    int num_tests = 7;
+    int num_tests = 9;
     bool test_passed[num_tests];
 
     UncompressedBitSet edges_set = UncompressedBitSet(3, max_malloc);
@@ -157,6 +225,8 @@ main(int argc, char const *argv[]) {
     test_passed[5] = test_remove_nonexistent(edges_set);
     edges_set = UncompressedBitSet(3, max_malloc);
     test_passed[6] = test_insert_existing(edges_set);
+    test_passed[7] = test_reset(max_malloc);
+    test_passed[8] = test_warning_handler();
 
     bool all_tests_passed = true;
     for (int i = 0; i < num_tests; i++) {
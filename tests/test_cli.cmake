@@ -0,0 +1,70 @@
+# Runs the `xswap` command-line tool on a small network. Called by ctest with
+# -DXSWAP=<path to the tool> -DWORK_DIR=<scratch directory>.
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(edges "")
+foreach(i RANGE 39)
+    math(EXPR target "(7 * ${i} + 3) % 40")
+    math(EXPR other_target "(11 * ${i}) % 40")
+    set(edges "${edges}${i},${target}\n${i},${other_target}\n")
+endforeach()
+file(WRITE ${WORK_DIR}/edges.csv "${edges}")
+
+function(run_xswap)
+    execute_process(COMMAND ${XSWAP} ${ARGN} RESULT_VARIABLE result ERROR_VARIABLE error)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "xswap ${ARGN} failed: ${error}")
+    endif()
+endfunction()
+
+# Outputs do not depend on the number of threads
+foreach(threads 1 3)
+    run_xswap(${WORK_DIR}/edges.csv -n 4 -s 5 -t ${threads} --allow-antiparallel
+              -o ${WORK_DIR}/t${threads}_{}.csv --stats ${WORK_DIR}/t${threads}.json)
+    run_xswap(${WORK_DIR}/edges.csv -n 4 -s 5 -t ${threads} --allow-antiparallel
+              -f ensemble -o ${WORK_DIR}/t${threads}.ensemble)
+endforeach()
+foreach(i RANGE 3)
+    file(READ ${WORK_DIR}/t1_${i}.csv single_threaded)
+    file(READ ${WORK_DIR}/t3_${i}.csv multi_threaded)
+    if(NOT single_threaded STREQUAL multi_threaded)
+        message(FATAL_ERROR "Permutation ${i} depends on the number of threads")
+    endif()
+    if(single_threaded STREQUAL edges)
+        message(FATAL_ERROR "Permutation ${i} is unchanged")
+    endif()
+endforeach()
+file(SHA256 ${WORK_DIR}/t1.ensemble single_threaded)
+file(SHA256 ${WORK_DIR}/t3.ensemble multi_threaded)
+if(NOT single_threaded STREQUAL multi_threaded)
+    message(FATAL_ERROR "Ensemble depends on the number of threads")
+endif()
+
+file(READ ${WORK_DIR}/t1.json single_threaded_stats)
+string(REGEX MATCHALL "\"seed\": [0-9]+, \"swap_attempts\": 800" permutation_stats
+       "${single_threaded_stats}")
+list(LENGTH permutation_stats num_permutation_stats)
+if(NOT num_permutation_stats EQUAL 4)
+    message(FATAL_ERROR "Unexpected statistics: ${single_threaded_stats}")
+endif()
+
+# Binary output can be read back as input
+run_xswap(${WORK_DIR}/edges.csv -f binary -o ${WORK_DIR}/permuted.xswap)
+run_xswap(${WORK_DIR}/permuted.xswap -o ${WORK_DIR}/repermuted.csv)
+
+# Multigraphs are rejected
+file(APPEND ${WORK_DIR}/edges.csv "0,3\n")
+execute_process(COMMAND ${XSWAP} ${WORK_DIR}/edges.csv -o ${WORK_DIR}/multigraph.csv
+                RESULT_VARIABLE result ERROR_VARIABLE error)
+if(result EQUAL 0 OR NOT error MATCHES "duplicate edges")
+    message(FATAL_ERROR "Duplicate edges were not rejected: ${error}")
+endif()
+
+# Negative sizes are rejected rather than read as huge unsigned values
+execute_process(COMMAND ${XSWAP} ${WORK_DIR}/permuted.xswap --max-malloc -1
+                -o ${WORK_DIR}/negative.csv RESULT_VARIABLE result ERROR_VARIABLE error)
+if(result EQUAL 0 OR NOT error MATCHES "--max-malloc is out of range")
+    message(FATAL_ERROR "A negative --max-malloc was not rejected: ${error}")
+endif()
@@ -15,6 +15,25 @@ def test_matrix_to_edges(matrix, correct_edges, include_reverse_edges):
     assert sorted(edges) == sorted(correct_edges)
 
 
+@pytest.mark.parametrize('include_reverse_edges', [True, False])
+@pytest.mark.parametrize('matrix_format', ['dense', 'csr', 'csc'])
+def test_matrix_to_edges_array(include_reverse_edges, matrix_format):
+    """
+    Check that edges returned as an array match the edge list for dense and
+    sparse matrices
+    """
+    matrix = numpy.array([[1,0,0,1],[0,0,1,0],[0,1,1,0],[1,0,0,0]])
+    edges = xswap.network_formats.matrix_to_edges(matrix, include_reverse_edges)
+    if matrix_format != 'dense':
+        matrix = getattr(scipy.sparse, matrix_format + '_matrix')(matrix)
+    edge_array = xswap.network_formats.matrix_to_edges(
+        matrix, include_reverse_edges, as_array=True)
+    assert edge_array.dtype == numpy.int32
+    assert edge_array.shape == (len(edges), 2)
+    assert edge_array.flags['C_CONTIGUOUS']
+    assert sorted(map(tuple, edge_array.tolist())) == sorted(edges)
+
+
 @pytest.mark.parametrize('edges,correct_matrix,add_reverse_edges,shape,dtype,sparse', [
     (
         [(0, 1), (0, 3), (2, 2)],
@@ -52,3 +71,94 @@ def test_edges_to_matrix(edges, correct_matrix, add_reverse_edges, shape, dtype,
         assert (matrix != correct_matrix).nnz == 0
     else:
         assert numpy.array_equal(matrix, correct_matrix)
+
+
+@pytest.mark.parametrize('add_reverse_edges', [True, False])
+@pytest.mark.parametrize('as_array', [True, False])
+def test_edges_to_matrix_inputs(add_reverse_edges, as_array):
+    """
+    Check that list and array inputs give the same matrix, with antiparallel
+    edges and self-loops entered once when reverse edges are added
+    """
+    edges = [(0, 1), (1, 0), (2, 2), (3, 1), (0, 3)]
+    correct_matrix = numpy.zeros((4, 4), dtype=int)
+    for source, target in edges:
+        correct_matrix[source, target] = 1
+        if add_reverse_edges:
+            correct_matrix[target, source] = 1
+    if as_array:
+        edges = numpy.array(edges, dtype=numpy.int64)
+    matrix = xswap.network_formats.edges_to_matrix(
+        edges, add_reverse_edges=add_reverse_edges, shape=(4, 4), dtype=int)
+    assert matrix.has_sorted_indices
+    assert numpy.array_equal(matrix.toarray(), correct_matrix)
+
+
+def test_edges_to_matrix_list_rows():
+    """
+    Check that edges given as lists rather than tuples are read, that repeated
+    edges are summed unless reverse edges are added, and that malformed edges
+    raise an error
+    """
+    matrix = xswap.network_formats.edges_to_matrix(
+        [[0, 1], [1, 2]], add_reverse_edges=False, shape=(3, 3), dtype=int, sparse=False)
+    assert numpy.array_equal(matrix, [[0, 1, 0], [0, 0, 1], [0, 0, 0]])
+
+    repeated = [(0, 1), (0, 1), (2, 0)]
+    matrix = xswap.network_formats.edges_to_matrix(
+        repeated, add_reverse_edges=False, shape=(3, 3), dtype=int, sparse=False)
+    assert numpy.array_equal(matrix, [[0, 2, 0], [0, 0, 0], [1, 0, 0]])
+    matrix = xswap.network_formats.edges_to_matrix(
+        repeated, add_reverse_edges=True, shape=(3, 3), dtype=int, sparse=False)
+    assert numpy.array_equal(matrix, [[0, 1, 1], [1, 0, 0], [1, 0, 0]])
+
+    with pytest.raises(ValueError, match='pairs'):
+        xswap.network_formats.edges_to_matrix([(0, 1, 2)], False, shape=(3, 3))
+    with pytest.raises(TypeError):
+        xswap.network_formats.edges_to_matrix([(0, 'a')], False, shape=(3, 3))
+
+
+@pytest.mark.parametrize('add_reverse_edges,shape', [(True, (11, 11)), (False, (11, 17))])
+def test_edges_to_packed_matrix(add_reverse_edges, shape):
+    """
+    Check that the bit-packed matrix matches `numpy.packbits` of the dense matrix
+    """
+    edges = [(0, 1), (1, 0), (2, 2), (3, 9), (10, 8), (7, 10), (0, 3)]
+    dense = xswap.network_formats.edges_to_matrix(
+        edges, add_reverse_edges=add_reverse_edges, shape=shape, dtype=bool, sparse=False)
+    packed = xswap.network_formats.edges_to_matrix(
+        edges, add_reverse_edges=add_reverse_edges, shape=shape, sparse=False, packed=True)
+    assert packed.dtype == numpy.uint8
+    assert packed.shape == (shape[0], -(-shape[1] // 8))
+    assert numpy.array_equal(packed, numpy.packbits(dense, axis=1))
+    unpacked = numpy.unpackbits(packed, axis=1, count=shape[1]).astype(bool)
+    assert numpy.array_equal(unpacked, dense)
+
+
+@pytest.mark.parametrize('bipartite,directed', [(False, False), (False, True), (True, True)])
+def test_generate_power_law_edges(bipartite, directed):
+    """
+    Check that generated networks are reproducible, valid for XSwap, and have
+    heavy-tailed degrees
+    """
+    shape = (3000, 2000) if bipartite else (3000, 3000)
+    edges = xswap.network_formats.generate_power_law_edges(
+        30000, shape, bipartite=bipartite, directed=directed, seed=1, as_array=True)
+    assert edges.dtype == numpy.int32
+    assert 25000 < len(edges) <= 30000
+    assert numpy.array_equal(edges, xswap.network_formats.generate_power_law_edges(
+        30000, shape, bipartite=bipartite, directed=directed, seed=1, as_array=True, n_jobs=3))
+    assert not numpy.array_equal(edges, xswap.network_formats.generate_power_law_edges(
+        30000, shape, bipartite=bipartite, directed=directed, seed=2, as_array=True))
+
+    assert edges[:, 0].max() < shape[0] and edges[:, 1].max() < shape[1]
+    assert len(set(map(tuple, edges.tolist()))) == len(edges)
+    if not bipartite:
+        assert numpy.all(edges[:, 0] != edges[:, 1])
+    if not directed:
+        assert numpy.all(edges[:, 0] < edges[:, 1])
+    source_degrees = numpy.bincount(edges[:, 0])
+    assert source_degrees.max() > 50 * numpy.median(source_degrees)
+
+    with pytest.raises(ValueError, match='square'):
+        xswap.network_formats.generate_power_law_edges(10, (3, 2))
@@ -1,7 +1,8 @@
-import tempfile
+import threading
+import time
 
+import numpy
 import pytest
-import requests
 
 import xswap
 
@@ -25,17 +26,197 @@ def test_xswap_changes_edges(edges, permutable):
         assert new_edges == edges
 
 
+def test_xswap_array_input():
+    """
+    Check that an edge array from `matrix_to_edges` is permuted exactly as the
+    equivalent list of tuples and returned as an int32 array
+    """
+    matrix = numpy.zeros((20, 20), dtype=int)
+    for i in range(20):
+        matrix[i, (3 * i + 1) % 20] = matrix[i, (7 * i + 2) % 20] = 1
+    edge_list = xswap.network_formats.matrix_to_edges(matrix)
+    edge_array = xswap.network_formats.matrix_to_edges(matrix, as_array=True)
+    new_list, list_stats = xswap.permute_edge_list(edge_list, seed=3)
+    new_array, array_stats = xswap.permute_edge_list(edge_array, seed=3)
+    assert new_array.dtype == numpy.int32
+    assert list(map(tuple, new_array.tolist())) == new_list
+    assert array_stats == list_stats
+
+    # Arrays with the right item size but another format or shape are rejected
+    for bad_array in [edge_array.astype(numpy.float32), edge_array.reshape(-1),
+                      edge_array.reshape(-1, 4)]:
+        with pytest.raises(ValueError, match='int32'):
+            xswap._xswap_backend._xswap(
+                bad_array, [], 19, False, False, 10, 0, 4000000000, False, False)
+
+
+@pytest.mark.filterwarnings('ignore:Using Roaring bitset')
+@pytest.mark.parametrize('max_malloc,backend', [
+    (4000000000, 'uncompressed'),
+    (1, 'roaring'),
+])
+def test_xswap_instrument(max_malloc, backend):
+    """
+    Check that instrumentation adds phase timings and counters to the stats
+    without changing the permutation
+    """
+    edges = [(i, (5 * i + 3) % 40) for i in range(40)] + [(i, (11 * i) % 40) for i in range(40)]
+    new_edges, stats = xswap.permute_edge_list(
+        edges, allow_antiparallel=True, seed=2, max_malloc=max_malloc)
+    profiled_edges, profile = xswap.permute_edge_list(
+        edges, allow_antiparallel=True, seed=2, max_malloc=max_malloc, hardware_counters=True)
+    assert profiled_edges == new_edges
+    assert {key: profile[key] for key in stats} == stats
+
+    rejected = sum(stats[key] for key in stats if key != 'swap_attempts')
+    assert profile['accepted_swaps'] == stats['swap_attempts'] - rejected > 0
+    assert profile['backend'] == backend
+    assert profile['bitset_bytes'] > 0
+    assert profile['edge_bytes'] >= 80 * 8
+    for phase in ['validation', 'input_conversion', 'bitset', 'swap', 'output_conversion']:
+        assert profile[phase + '_seconds'] >= 0
+    for counter in ['cycles', 'cache_misses']:
+        assert profile[counter] is None or profile[counter] >= 0
+
+
+def test_permute_edge_file(tmp_path):
+    """
+    Check that permuting a binary edge file matches permuting the edge list,
+    both when returning edges and when writing them to a new file, and that the
+    input file is unchanged
+    """
+    edges = [(i, (5 * i + 3) % 40) for i in range(40)] + [(i, (11 * i) % 40) for i in range(40)]
+    input_path = tmp_path.joinpath('edges.xswap')
+    output_path = tmp_path.joinpath('permuted.xswap')
+    xswap.preprocessing.write_edges(input_path, edges, binary=True)
+    input_bytes = input_path.read_bytes()
+
+    new_edges, stats = xswap.permute_edge_list(edges, allow_antiparallel=True, seed=5)
+    file_edges, file_stats = xswap.permute_edge_file(
+        input_path, allow_antiparallel=True, seed=5)
+    assert list(map(tuple, file_edges.tolist())) == new_edges
+    assert file_stats == stats
+
+    returned, _ = xswap.permute_edge_file(
+        input_path, output_path, allow_antiparallel=True, seed=5)
+    assert returned is None
+    assert xswap.preprocessing.load_processed_edges(output_path) == new_edges
+    assert input_path.read_bytes() == input_bytes
+
+    # Corrupted edges are rejected rather than permuted and given a valid checksum
+    corrupted = bytearray(input_bytes)
+    corrupted[64 + 4] ^= 1
+    input_path.write_bytes(bytes(corrupted))
+    with pytest.raises(ValueError, match='Checksum'):
+        xswap.permute_edge_file(input_path, output_path)
+
+
+@pytest.mark.parametrize('output_format', ['text', 'binary', 'ensemble'])
+@pytest.mark.parametrize('background_io,n_jobs', [(True, 1), (False, 1), (False, 3)])
+def test_write_permutations(tmp_path, output_format, background_io, n_jobs):
+    """
+    Check that permutations written by the backend match `permute_edge_list`
+    with the corresponding seeds, whatever the number of threads
+    """
+    edges = [(i, (5 * i + 3) % 40) for i in range(40)] + [(i, (11 * i) % 40) for i in range(40)]
+    if output_format == 'ensemble':
+        path = tmp_path.joinpath('ensemble.xswap')
+    else:
+        path = tmp_path.joinpath('{}.' + output_format)
+    stats = xswap.write_permutations(
+        edges, path, 5, output_format, allow_antiparallel=True, seed=10,
+        background_io=background_io, n_jobs=n_jobs)
+    assert len(stats) == 5
+
+    if output_format == 'ensemble':
+        ensemble = xswap.preprocessing.PermutationEnsemble(path)
+    for i in range(5):
+        new_edges, new_stats = xswap.permute_edge_list(
+            edges, allow_antiparallel=True, seed=10 + i)
+        assert stats[i] == new_stats
+        if output_format == 'ensemble':
+            written = list(map(tuple, ensemble[i].tolist()))
+        else:
+            written = xswap.preprocessing.load_processed_edges(
+                str(path).format(i))
+        assert written == new_edges
+
+    with pytest.raises(ValueError, match='non-negative'):
+        xswap.write_permutations(edges, path, -1, output_format)
+
+
+@pytest.mark.parametrize('n_jobs', [1, 3])
+def test_permute_hetnet(n_jobs):
+    """
+    Check that permuting metaedges together matches permuting each one with
+    `permute_edge_list`, and that warnings from worker threads reach Python
+    """
+    metaedges = {
+        'small': [(0, 1), (1, 2), (2, 3), (3, 0)],
+        'bipartite': {
+            'edges': numpy.array([(i, (3 * i) % 50) for i in range(50)]
+                                 + [(i, (7 * i + 1) % 50) for i in range(50)]),
+            'allow_self_loops': True, 'allow_antiparallel': True, 'seed': 4,
+        },
+        'undirected': {
+            'edges': [(i, i + j) for i in range(30) for j in (1, 2, 5)],
+            'multiplier': 3, 'excluded_edges': {(0, 7)},
+        },
+    }
+    permuted, stats = xswap.permute_hetnet(metaedges, seed=2, n_jobs=n_jobs)
+    assert list(permuted) == list(metaedges)
+    for name, options in metaedges.items():
+        if not isinstance(options, dict):
+            options = {'edges': options}
+        options = dict(options)
+        edges = options.pop('edges')
+        options.setdefault('seed', 2)
+        new_edges, new_stats = xswap.permute_edge_list(edges, **options)
+        assert stats[name] == new_stats
+        if isinstance(edges, list):
+            assert permuted[name] == new_edges
+        else:
+            assert numpy.array_equal(permuted[name], new_edges)
+
+    with pytest.warns(RuntimeWarning, match='Roaring'):
+        xswap.permute_hetnet(metaedges, max_malloc=1, n_jobs=n_jobs)
+    with pytest.raises(ValueError, match='directed'):
+        xswap.permute_hetnet({'small': {'edges': [(0, 1)], 'directed': True}})
+
+
+def test_xswap_releases_gil():
+    """
+    Check that other Python threads run while the backend permutes
+    """
+    edges = xswap.network_formats.generate_power_law_edges(
+        100000, (10000, 10000), seed=1, as_array=True)
+    ticks = []
+    stop = threading.Event()
+
+    def tick():
+        while not stop.is_set():
+            ticks.append(time.time())
+            time.sleep(0.001)
+
+    ticker = threading.Thread(target=tick)
+    ticker.start()
+    try:
+        time.sleep(0.01)
+        start = time.time()
+        xswap.permute_edge_list(edges, allow_antiparallel=True, multiplier=20)
+        end = time.time()
+    finally:
+        stop.set()
+        ticker.join()
+    assert sum(start < t < end for t in ticks) > 10
+
+
 def test_roaring_warning():
     """
     Check that a warning is given when using the much slower but far more general
     Roaring bitset rather than the faster fully uncompressed bitset.
     """
-    edges_url = "https://github.com/greenelab/xswap/raw/{}/{}".format(
-        "8c31b4cbdbbf2cfa5018b1277bbd0e9f6263e573", "graphs/GiG_edges_reduced.txt")
-    response = requests.get(edges_url)
-    with tempfile.NamedTemporaryFile() as tf:
-        tf.write(response.content)
-        edges = xswap.preprocessing.load_processed_edges(tf.name)
+    edges = xswap.network_formats.generate_power_law_edges(5000, (1000, 1000))
 
     with pytest.warns(None):
         permuted_edges, stats = xswap.permute_edge_list(edges, allow_self_loops=True,
@@ -0,0 +1,144 @@
+import numpy
+import pytest
+
+import xswap.preprocessing
+
+
+@pytest.mark.parametrize('node_delim,edge_delim', [(',', '\n'), ('\t', '\n'), (' ', ';')])
+@pytest.mark.parametrize('n_jobs', [1, 3])
+def test_load_processed_edges(tmp_path, node_delim, edge_delim, n_jobs):
+    """
+    Check that the native loader matches parsing with `int`, skipping lines
+    with a single field and ignoring extra fields
+    """
+    rows = ['{}{}{}'.format(i, node_delim, (7 * i) % 5000) for i in range(5000)]
+    rows[10] = ''
+    rows[20] = '12'
+    rows[30] = '+4{}9{}extra\r'.format(node_delim, node_delim)
+    path = tmp_path.joinpath('edges.txt')
+    path.write_bytes(edge_delim.join(rows).encode())
+
+    correct_edges = [
+        (int(fields[0]), int(fields[1]))
+        for fields in (row.split(node_delim) for row in rows) if len(fields) > 1
+    ]
+    edges = xswap.preprocessing.load_processed_edges(
+        path, node_delim=node_delim, edge_delim=edge_delim, n_jobs=n_jobs)
+    assert edges == correct_edges
+
+    edge_array = xswap.preprocessing.load_processed_edges(
+        path, node_delim=node_delim, edge_delim=edge_delim, as_array=True, n_jobs=n_jobs)
+    assert edge_array.dtype == numpy.int32
+    assert numpy.array_equal(edge_array, numpy.array(correct_edges))
+
+
+def test_load_processed_edges_errors(tmp_path):
+    path = tmp_path.joinpath('edges.csv')
+    path.write_text('0,1\n1,2\n2,b\n')
+    with pytest.raises(ValueError, match="line 3: '2,b'"):
+        xswap.preprocessing.load_processed_edges(path)
+    with pytest.raises(OSError):
+        xswap.preprocessing.load_processed_edges(tmp_path.joinpath('missing.csv'))
+
+
+@pytest.mark.parametrize('bipartite', [True, False])
+@pytest.mark.parametrize('n_jobs', [1, 4])
+def test_map_str_edges(bipartite, n_jobs):
+    """
+    Check that native mapping matches sorting names in Python, including
+    non-ASCII names and prefixes of other names
+    """
+    random_state = numpy.random.RandomState(0)
+    names = ['n{}'.format(i) for i in random_state.randint(0, 20000, size=10000)]
+    names += ['', 'n', 'é', 'ü', 'z日', '\U0001f600']
+    edges = [(names[i], names[j]) for i, j in random_state.randint(0, len(names), (30000, 2))]
+
+    correct = xswap.preprocessing._map_str_edges_python(edges, bipartite)
+    mapped_edges, source_map, target_map = xswap.preprocessing.map_str_edges(
+        edges, bipartite, n_jobs=n_jobs)
+    assert mapped_edges == correct[0]
+    assert list(source_map.items()) == list(correct[1].items())
+    assert list(target_map.items()) == list(correct[2].items())
+
+    edge_array, _, _ = xswap.preprocessing.map_str_edges(
+        edges, bipartite, as_array=True, n_jobs=n_jobs)
+    assert numpy.array_equal(edge_array, numpy.array(correct[0]))
+
+
+def test_binary_edge_file(tmp_path):
+    """
+    Check that binary edge files round-trip with their header, and that a
+    corrupted file is rejected
+    """
+    edges = [(0, 3), (2, 1), (5, 0), (4, 4)]
+    path = tmp_path.joinpath('edges.xswap')
+    xswap.preprocessing.write_edges(path, edges, binary=True, bipartite=True)
+    header = xswap.preprocessing.read_binary_header(path)
+    assert header['num_edges'] == 4
+    assert (header['max_source_id'], header['max_target_id']) == (5, 4)
+    assert header['bipartite'] and not header['directed']
+    assert xswap.preprocessing.load_processed_edges(path) == edges
+
+    data = bytearray(path.read_bytes())
+    data[-1] ^= 1
+    path.write_bytes(bytes(data))
+    with pytest.raises(ValueError, match='Checksum'):
+        xswap.preprocessing.load_processed_edges(path)
+    with pytest.raises(ValueError, match='duplicate'):
+        xswap.preprocessing.write_edges(path, edges + [(0, 3)], binary=True)
+
+
+def test_permutation_ensemble(tmp_path):
+    """
+    Check that permutations are read back from an ensemble file exactly, by
+    index and after appending, and that unchanged targets take little space
+    """
+    edges = numpy.array([(i, (7 * i + 1) % 50) for i in range(50)]
+                        + [(i, (3 * i) % 50) for i in range(50)], dtype=numpy.int32)
+    permutations = [
+        xswap.permute_edge_list(edges, allow_antiparallel=True, multiplier=multiplier, seed=seed)[0]
+        for seed, multiplier in enumerate([0, 0.01, 10, 10])
+    ]
+    path = tmp_path.joinpath('ensemble.xswap')
+    xswap.preprocessing.write_ensemble(path, edges, permutations[:3])
+    assert xswap.preprocessing.append_to_ensemble(path, permutations[3:]) == 4
+
+    ensemble = xswap.preprocessing.PermutationEnsemble(path)
+    assert len(ensemble) == 4
+    assert numpy.array_equal(ensemble.edges, edges)
+    for index in [2, 0, -1, 1]:
+        assert numpy.array_equal(ensemble[index], permutations[index])
+    with pytest.raises(IndexError):
+        ensemble[4]
+
+    # An unchanged permutation is a 16-byte block header and one varint for the
+    # run of 100 unchanged targets
+    unchanged_path = tmp_path.joinpath('unchanged.xswap')
+    xswap.preprocessing.write_ensemble(unchanged_path, edges, [edges])
+    assert unchanged_path.stat().st_size == 64 + edges.nbytes + 16 + 2
+
+    moved_source = edges.copy()
+    moved_source[0, 0] += 1
+    with pytest.raises(ValueError, match='different sources'):
+        xswap.preprocessing.append_to_ensemble(path, [moved_source])
+
+
+def test_ensemble_append_after_partial_block(tmp_path):
+    """
+    Check that appending after an interrupted append overwrites the partial
+    block, so that all counted permutations stay readable
+    """
+    edges = numpy.array([(i, (7 * i + 1) % 30) for i in range(30)], dtype=numpy.int32)
+    permutations = [
+        xswap.permute_edge_list(edges, allow_antiparallel=True, seed=seed)[0]
+        for seed in range(2)
+    ]
+    path = tmp_path.joinpath('ensemble.xswap')
+    xswap.preprocessing.write_ensemble(path, edges, permutations[:1])
+    with open(str(path), 'ab') as f:
+        f.write(b'\x05\x00\x00')
+    assert xswap.preprocessing.append_to_ensemble(path, permutations[1:]) == 2
+
+    ensemble = xswap.preprocessing.PermutationEnsemble(path)
+    for index in range(2):
+        assert numpy.array_equal(ensemble[index], permutations[index])
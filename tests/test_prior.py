@@ -27,6 +27,32 @@ def test_prior_matrix(edges, true_prior, num_swaps, shape):
     assert numpy.abs(edge_prior - true_prior).max() == pytest.approx(0, abs=0.01)
 
 
+@pytest.mark.parametrize('allow_antiparallel', [True, False])
+@pytest.mark.parametrize('sparse', [True, False])
+def test_occurrence_matrix_matches_permutations(allow_antiparallel, sparse):
+    """
+    Check that occurrences counted in the backend equal the sum of the
+    adjacency matrices of the individual permutations
+    """
+    edges = [(0, 1), (0, 3), (1, 2), (2, 4), (3, 4), (4, 5), (1, 5)]
+    shape = (6, 6)
+    expected = numpy.zeros(shape, dtype=int)
+    for seed in range(3, 8):
+        permuted_edges, stats = xswap.permute_edge_list(
+            edges, allow_self_loops=False, allow_antiparallel=allow_antiparallel,
+            seed=seed)
+        expected += xswap.network_formats.edges_to_matrix(
+            permuted_edges, add_reverse_edges=(not allow_antiparallel),
+            shape=shape, dtype=int, sparse=False)
+
+    occurrence_matrix = xswap.prior.compute_xswap_occurrence_matrix(
+        edges, n_permutations=5, shape=shape, allow_self_loops=False,
+        allow_antiparallel=allow_antiparallel, sparse=sparse, initial_seed=3)
+    if sparse:
+        occurrence_matrix = occurrence_matrix.toarray()
+    assert numpy.array_equal(occurrence_matrix, expected)
+
+
 @pytest.mark.parametrize('edges,dtypes,source_degrees,target_degrees,shape,allow_antiparallel', [
     (
         [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)],
@@ -72,3 +98,220 @@ def test_prior_dataframe(edges, dtypes, source_degrees, target_degrees, shape, a
         assert prior_df['edge'].sum() == len(edges)
     else:
         assert prior_df['edge'].sum() == len(edges) * 2
+
+
+@pytest.mark.parametrize('allow_antiparallel', [True, False])
+def test_degree_priors(allow_antiparallel):
+    """
+    Check that the degree-pair table agrees with the per-pair priors and with
+    occurrences counted for every node pair
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)]
+    shape = (5, 5)
+    degree_prior_df = xswap.prior.compute_xswap_degree_priors(
+        edges, n_permutations=50, shape=shape, allow_antiparallel=allow_antiparallel)
+    assert list(degree_prior_df.columns) == ['source_degree', 'target_degree', 'num_pairs',
+                                             'num_permuted_edges', 'xswap_prior']
+    assert degree_prior_df['num_pairs'].sum() == shape[0] * shape[1]
+
+    occurrence_matrix = xswap.prior.compute_xswap_occurrence_matrix(
+        edges, n_permutations=50, shape=shape, allow_antiparallel=allow_antiparallel)
+    assert degree_prior_df['num_permuted_edges'].sum() == occurrence_matrix.sum()
+
+    prior_df = xswap.prior.compute_xswap_priors(
+        edges, n_permutations=50, shape=shape, allow_antiparallel=allow_antiparallel)
+    merged = prior_df.merge(degree_prior_df, on=['source_degree', 'target_degree'])
+    assert len(merged) == len(prior_df)
+    assert numpy.allclose(merged['xswap_prior_x'], merged['xswap_prior_y'])
+
+
+def test_hetnet_degree_priors():
+    """
+    Check that batch priors match computing each metaedge separately
+    """
+    metaedges = {
+        'undirected': {'edges': [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)], 'shape': (5, 5)},
+        'bipartite': {
+            'edges': numpy.array([(i, (3 * i) % 7) for i in range(10)]), 'shape': (10, 7),
+            'allow_self_loops': True, 'allow_antiparallel': True,
+        },
+    }
+    degree_priors = xswap.prior.compute_hetnet_degree_priors(
+        metaedges, n_permutations=20, initial_seed=3, n_jobs=2)
+    assert list(degree_priors) == list(metaedges)
+    for name, options in metaedges.items():
+        options = dict(options)
+        expected = xswap.prior.compute_xswap_degree_priors(
+            options.pop('edges'), n_permutations=20, shape=options.pop('shape'),
+            initial_seed=3, **options)
+        pandas.testing.assert_frame_equal(degree_priors[name], expected)
+
+    with pytest.raises(ValueError, match='shape'):
+        xswap.prior.compute_hetnet_degree_priors({'x': {'edges': [(0, 1)]}}, 10)
+
+
+@pytest.mark.parametrize('block_size', [1, 2, 5, 10])
+def test_iter_priors(block_size):
+    """
+    Check that concatenated prior blocks equal the full prior DataFrame
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)]
+    prior_df = xswap.prior.compute_xswap_priors(edges, n_permutations=20, shape=(5, 5))
+    blocks = list(xswap.prior.iter_xswap_priors(
+        edges, n_permutations=20, shape=(5, 5), block_size=block_size))
+    assert len(blocks) == -(-5 // block_size)
+    assert all(len(block) <= block_size * 5 for block in blocks)
+    pandas.testing.assert_frame_equal(pandas.concat(blocks), prior_df)
+
+
+@pytest.mark.parametrize('allow_antiparallel', [True, False])
+def test_query_priors(allow_antiparallel):
+    """
+    Check that priors for queried node pairs match the full computations
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)]
+    shape = (5, 5)
+    queries = [(0, 2), (4, 4), (1, 3), (0, 2), (3, 0)]
+    query_df = xswap.prior.compute_xswap_query_priors(
+        edges, queries, n_permutations=30, shape=shape,
+        allow_antiparallel=allow_antiparallel)
+    assert list(query_df.columns) == [
+        'source_id', 'target_id', 'edge', 'source_degree', 'target_degree',
+        'num_permuted_edges', 'pair_prior', 'xswap_prior']
+    assert list(zip(query_df['source_id'], query_df['target_id'])) == queries
+
+    occurrence_matrix = xswap.prior.compute_xswap_occurrence_matrix(
+        edges, n_permutations=30, shape=shape, allow_antiparallel=allow_antiparallel)
+    prior_df = xswap.prior.compute_xswap_priors(
+        edges, n_permutations=30, shape=shape, allow_antiparallel=allow_antiparallel)
+    for i, (source, target) in enumerate(queries):
+        row = query_df.iloc[i]
+        full_row = prior_df.iloc[source * shape[1] + target]
+        assert row['num_permuted_edges'] == occurrence_matrix[source, target]
+        assert row['pair_prior'] == pytest.approx(occurrence_matrix[source, target] / 30)
+        assert row['edge'] == full_row['edge']
+        assert row['source_degree'] == full_row['source_degree']
+        assert row['target_degree'] == full_row['target_degree']
+        assert row['xswap_prior'] == pytest.approx(full_row['xswap_prior'])
+
+
+@pytest.mark.parametrize('sparse', [True, False])
+def test_parallel_priors_identical(sparse):
+    """
+    Check that results do not depend on the number of threads
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4), (1, 4), (0, 4)]
+    shape = (5, 5)
+    serial = xswap.prior.compute_xswap_occurrence_matrix(
+        edges, n_permutations=37, shape=shape, sparse=sparse, n_jobs=1)
+    serial_df = xswap.prior.compute_xswap_degree_priors(
+        edges, n_permutations=37, shape=shape, n_jobs=1)
+    for n_jobs in [2, 3, 8, 64]:
+        parallel = xswap.prior.compute_xswap_occurrence_matrix(
+            edges, n_permutations=37, shape=shape, sparse=sparse, n_jobs=n_jobs)
+        if sparse:
+            assert (serial != parallel).nnz == 0
+        else:
+            assert numpy.array_equal(serial, parallel)
+            # Workers count in hashes when a dense copy exceeds max_malloc
+            hashed = xswap.prior.compute_xswap_occurrence_matrix(
+                edges, n_permutations=37, shape=shape, sparse=False, max_malloc=100,
+                n_jobs=n_jobs)
+            assert numpy.array_equal(serial, hashed)
+        parallel_df = xswap.prior.compute_xswap_degree_priors(
+            edges, n_permutations=37, shape=shape, n_jobs=n_jobs)
+        pandas.testing.assert_frame_equal(serial_df, parallel_df)
+
+
+def test_prior_accumulator(tmp_path):
+    """
+    Check that permutations added in batches, including across a save and
+    load, match a single computation, and that the stopping rule converges
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4), (1, 4)]
+    expected_df = xswap.prior.compute_xswap_degree_priors(
+        edges, n_permutations=30, shape=(5, 5), initial_seed=7)
+
+    accumulator = xswap.prior.XSwapPriorAccumulator(edges, shape=(5, 5), initial_seed=7)
+    assert numpy.isinf(accumulator.max_ci_width())
+    accumulator.add_permutations(10)
+    accumulator.save(tmp_path / 'accumulator.npz')
+    accumulator = xswap.prior.XSwapPriorAccumulator.load(tmp_path / 'accumulator.npz')
+    assert accumulator.n_permutations == 10
+    accumulator.add_permutations(20, n_jobs=2)
+
+    degree_prior_df = accumulator.degree_priors()
+    pandas.testing.assert_frame_equal(
+        degree_prior_df.drop(columns='standard_error'), expected_df, check_dtype=False)
+    assert (degree_prior_df['standard_error'] >= 0).all()
+
+    assert accumulator.run_until(max_ci_width=0.2, batch_size=50)
+    assert accumulator.max_ci_width() <= 0.2
+    assert not accumulator.run_until(max_ci_width=0, max_permutations=accumulator.n_permutations + 5)
+
+
+@pytest.mark.parametrize('dtype', [numpy.float32, numpy.float64])
+def test_approximate_prior_matrix(dtype):
+    """
+    Check that the native approximate prior matches the elementwise formula
+    """
+    edges = [(0, 2), (0, 3), (1, 2), (2, 3), (3, 4)]
+    prior_df = xswap.prior.compute_xswap_priors(edges, n_permutations=1, shape=(5, 5))
+    expected = xswap.prior.approximate_xswap_prior(
+        prior_df['source_degree'].astype(float), prior_df['target_degree'].astype(float),
+        len(edges)).values.reshape(5, 5)
+
+    prior_matrix = xswap.prior.approximate_xswap_prior_matrix(edges, shape=(5, 5), dtype=dtype)
+    assert prior_matrix.dtype == dtype
+    assert numpy.allclose(prior_matrix, expected, rtol=1e-6)
+
+    degree_prior_df = xswap.prior.approximate_xswap_degree_priors(edges, shape=(5, 5))
+    merged = prior_df.merge(degree_prior_df, how='left', on=['source_degree', 'target_degree'])
+    assert numpy.allclose(merged['approximate_prior'], expected.flatten())
+
+    # Degree and prior tables must be passed to the backend with their own dtype
+    degrees = numpy.array([1, 2], dtype=numpy.int32)
+    with pytest.raises(ValueError, match='int32'):
+        xswap._xswap_backend._approximate_degree_pairs(
+            degrees.astype(numpy.float32), degrees, 5.0)
+    with pytest.raises(ValueError, match='float64'):
+        xswap._xswap_backend._scatter_degree_pairs(
+            numpy.ones(4, dtype=numpy.float32), 2, degrees, degrees, 0, 2)
+
+
+def test_hybrid_priors():
+    """
+    Check that the corrected approximation is closer to a many-permutation
+    prior than the uncorrected approximation
+    """
+    rng = numpy.random.RandomState(0)
+    weights = rng.pareto(1.5, size=(2, 100)) + 1
+    sources = rng.choice(100, size=2000, p=weights[0] / weights[0].sum())
+    targets = rng.choice(100, size=2000, p=weights[1] / weights[1].sum())
+    edges = sorted(set(zip(sources.tolist(), targets.tolist())))
+
+    reference_df = xswap.prior.compute_xswap_degree_priors(
+        edges, n_permutations=200, shape=(100, 100), allow_antiparallel=True)
+    degree_prior_df, metrics = xswap.prior.compute_hybrid_xswap_priors(
+        edges, shape=(100, 100), n_permutations=5, allow_antiparallel=True,
+        reference_priors=reference_df)
+    assert len(degree_prior_df) == len(reference_df)
+    assert degree_prior_df['xswap_prior'].between(0, 1).all()
+    assert metrics['hybrid_rmse'] < metrics['approximate_rmse']
+    assert metrics['hybrid_mae'] < metrics['approximate_mae']
+    assert metrics['num_degree_pairs'] == len(reference_df)
+
+    # Metrics need a reference, and only cover the degree pairs it contains
+    _, no_metrics = xswap.prior.compute_hybrid_xswap_priors(
+        edges, shape=(100, 100), n_permutations=5, allow_antiparallel=True)
+    assert no_metrics is None
+    partial_df = reference_df.iloc[::2]
+    _, partial_metrics = xswap.prior.compute_hybrid_xswap_priors(
+        edges, shape=(100, 100), n_permutations=5, allow_antiparallel=True,
+        reference_priors=partial_df)
+    assert partial_metrics['num_degree_pairs'] == len(partial_df)
+    assert all(numpy.isfinite(value) for value in partial_metrics.values())
+    with pytest.raises(ValueError, match='none of the degree pairs'):
+        xswap.prior.compute_hybrid_xswap_priors(
+            edges, shape=(100, 100), n_permutations=5, allow_antiparallel=True,
+            reference_priors=partial_df.assign(source_degree=-1))
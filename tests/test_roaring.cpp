@@ -2,7 +2,7 @@
 #include "../xswap/src/xswap.h"
 
 
-main(int argc, char const *argv[])
+int main(int argc, char const *argv[])
 {
     int counter, incorrect_contains, incorrect_doesnt_contain;
 
@@ -1,23 +1,16 @@
 import os
 import time
 
-import requests
-
 import xswap
 
 test_directory = os.path.dirname(os.path.realpath(__file__)) + '/'
 
 
 def load_edges():
-    edges_url = "https://github.com/greenelab/xswap/raw/{}/{}".format(
-        "8c31b4cbdbbf2cfa5018b1277bbd0e9f6263e573", "graphs/GiG_edges_reduced.txt")
-    response = requests.get(edges_url)
-    edges = list()
-    for edge in response.iter_lines():
-        edge = str(edge, 'utf-8')
-        source, target = edge.split(',')
-        edges.append((int(source), int(target)))
-    return edges
+    """
+    Synthetic undirected network of about 200,000 edges with power-law degrees
+    """
+    return xswap.network_formats.generate_power_law_edges(200000, (20000, 20000))
 
 
 def test_time():
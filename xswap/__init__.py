@@ -1,18 +1,37 @@
 from xswap import network_formats
 from xswap import preprocessing
 from xswap import prior
-from xswap.permute import permute_edge_list
+from xswap.permute import (
+    permute_edge_file, permute_edge_list, permute_hetnet, write_permutations)
 
 __version__ = '0.0.2'
 
 __all__ = [
     'network_formats.edges_to_matrix',
     'network_formats.matrix_to_edges',
+    'network_formats.generate_power_law_edges',
     'permute_edge_list',
+    'permute_edge_file',
+    'permute_hetnet',
+    'write_permutations',
     'preprocessing.load_str_edges',
     'preprocessing.load_processed_edges',
     'preprocessing.map_str_edges',
+    'preprocessing.write_edges',
+    'preprocessing.read_binary_header',
+    'preprocessing.write_ensemble',
+    'preprocessing.append_to_ensemble',
+    'preprocessing.PermutationEnsemble',
     'prior.compute_xswap_occurrence_matrix',
     'prior.compute_xswap_priors',
+    'prior.compute_xswap_degree_priors',
+    'prior.compute_hetnet_degree_priors',
+    'prior.iter_hetnet_degree_priors',
+    'prior.iter_xswap_priors',
+    'prior.compute_xswap_query_priors',
+    'prior.XSwapPriorAccumulator',
     'prior.approximate_xswap_prior',
+    'prior.approximate_xswap_degree_priors',
+    'prior.approximate_xswap_prior_matrix',
+    'prior.compute_hybrid_xswap_priors',
 ]
@@ -1,12 +1,15 @@
+import os
 from typing import List, Tuple, TypeVar
 
 import numpy
 import scipy.sparse
 
 
-def matrix_to_edges(matrix: numpy.ndarray, include_reverse_edges: bool=True):
+def matrix_to_edges(matrix: numpy.ndarray, include_reverse_edges: bool=True,
+                    as_array: bool=False):
     """
     Convert (bi)adjacency matrix to an edge list. Inverse of `edges_to_matrix`.
+    Edges are extracted and filtered with vectorized numpy operations.
 
     Parameters
     ----------
@@ -18,33 +21,53 @@ def matrix_to_edges(matrix: numpy.ndarray, include_reverse_edges: bool=True):
         then only edges where source <= target are returned. This parameter
         should be `True` when passing a biadjacency matrix, as matrix positions
         indicate separate nodes.
+    as_array : bool
+        Whether to return a packed int32 array of shape (num_edges, 2), which
+        the permutation and prior functions read without conversion, rather
+        than a list of tuples.
 
     Returns
     -------
-    edge_list : List[Tuple[int, int]]
+    edge_list : List[Tuple[int, int]] or numpy.ndarray
         Edge list with node ids as the corresponding matrix indices. For example,
         if `matrix` has `matrix[0, 2] == 1`, then `(0, 2)` will be among the
         returned edges.
     """
-    sparse = scipy.sparse.coo_matrix(matrix)
-    edges = zip(sparse.row, sparse.col)
+    if scipy.sparse.issparse(matrix):
+        sparse = matrix.tocoo()
+        sources, targets = sparse.row, sparse.col
+    else:
+        sources, targets = numpy.nonzero(numpy.asarray(matrix))
 
     if not include_reverse_edges:
-        edges = filter(lambda edge: edge[0] <= edge[1], edges)
-    return list(edges)
+        upper_triangle = sources <= targets
+        sources, targets = sources[upper_triangle], targets[upper_triangle]
+
+    if as_array:
+        edges = numpy.empty((len(sources), 2), dtype=numpy.int32)
+        edges[:, 0] = sources
+        edges[:, 1] = targets
+        return edges
+    return list(zip(sources.tolist(), targets.tolist()))
 
 
 def edges_to_matrix(edge_list: List[Tuple[int, int]], add_reverse_edges: bool,
-                    shape: Tuple[int, int], dtype: TypeVar=bool, sparse: bool=True):
+                    shape: Tuple[int, int], dtype: TypeVar=bool, sparse: bool=True,
+                    packed: bool=False):
     """
     Convert edge list to (bi)adjacency matrix. Inverse of `matrix_to_edges`.
+    The compressed sparse column structure, including any reverse edges, is
+    built by the backend in a single counting-sort pass.
 
     Parameters
     ----------
-    edge_list : List[Tuple[int, int]]
+    edge_list : List[Tuple[int, int]] or numpy.ndarray
         An edge list mapped such that node ids correspond to desired matrix
         positions. For example, (0, 0) will mean that the resulting matrix has
-        a positive value of type `dtype` in that position.
+        a positive value of type `dtype` in that position. Lists of pairs are
+        read by the backend directly, as are int32 arrays of shape
+        (num_edges, 2). Without `add_reverse_edges`, an edge listed several
+        times has the number of times it is listed as its value.
     add_reverse_edges : bool
         Whether to include the reverse of edges in the matrix. For example,
         if `edge_list = [(1, 0)]` and `add_reverse_edge = True`, then the
@@ -59,20 +82,149 @@ def edges_to_matrix(edge_list: List[Tuple[int, int]], add_reverse_edges: bool,
     sparse : bool
         Whether a sparse matrix should be returned. If `False`, returns a dense
         numpy.ndarray
+    packed : bool
+        Whether to return a dense matrix with eight node pairs per byte. Requires
+        `sparse=False`, and `dtype` is ignored. The result has dtype uint8 and
+        shape `(shape[0], ceil(shape[1] / 8))`, and equals
+        `numpy.packbits(dense_matrix, axis=1)`. Use `numpy.unpackbits(matrix,
+        axis=1, count=shape[1])` to recover the boolean matrix.
 
     Returns
     -------
     matrix : scipy.sparse.csc_matrix or numpy.ndarray
     """
-    matrix = scipy.sparse.csc_matrix(
-        (numpy.ones(len(edge_list)), zip(*edge_list)), dtype=dtype, shape=shape,
-    )
+    import xswap._xswap_backend
+    if packed:
+        if sparse:
+            raise ValueError("A packed matrix is dense. Use sparse=False.")
+        if not isinstance(edge_list, list):
+            edge_list = _edge_array(edge_list)
+        matrix = xswap._xswap_backend._edges_to_packed(
+            edge_list, shape[0], shape[1], add_reverse_edges)
+        return numpy.frombuffer(matrix, dtype=numpy.uint8).reshape(shape[0], -(-shape[1] // 8))
 
+    if not isinstance(edge_list, list):
+        edge_list = _edge_array(edge_list)
+    indptr, indices, counts = xswap._xswap_backend._edges_to_compressed(
+        edge_list, shape[0], shape[1], add_reverse_edges, True)
+    indices = numpy.frombuffer(indices, dtype=numpy.int32)
     if add_reverse_edges:
-        matrix = (matrix + matrix.T) > 0
-        matrix = matrix.astype(dtype)
+        data = numpy.ones(len(indices), dtype=dtype)
+    else:
+        data = numpy.frombuffer(counts, dtype=numpy.int32).astype(dtype)
+    matrix = scipy.sparse.csc_matrix(
+        (data, indices,
+         numpy.frombuffer(indptr, dtype=numpy.int64)),
+        shape=shape,
+    )
 
     if not sparse:
         matrix = matrix.toarray()
 
     return matrix
+
+
+def generate_power_law_edges(num_edges: int, shape: Tuple[int, int],
+                             exponent: float = 2.5, bipartite: bool = False,
+                             directed: bool = False, seed: int = 0,
+                             as_array: bool = False, n_jobs: int = 1):
+    """
+    Generate a random network with power-law degrees in the backend, by the
+    erased configuration model. Stubs are spread over the nodes with expected
+    degrees following a power law, paired at random, and pairs that XSwap
+    would reject are erased, so the result has slightly fewer than
+    `num_edges` edges. The network depends only on the arguments other than
+    `n_jobs`, so it can stand in for downloaded networks in tests and
+    benchmarks at any size.
+
+    Parameters
+    ----------
+    num_edges : int
+        Number of edges before erasing duplicates, self-loops and, for
+        undirected networks, reverse edges
+    shape : Tuple[int, int]
+        The shape of the (bi)adjacency matrix, which must be square unless
+        `bipartite`
+    exponent : float
+        Exponent of the power-law tail of the degree distribution, greater
+        than 1. Real networks typically have exponents between 2 and 3.
+    bipartite : bool
+        Whether sources and targets are separate sets of nodes. Self-loops
+        are kept for bipartite networks, where they join distinct nodes.
+    directed : bool
+        Whether both an edge and its reverse may be kept. Undirected edges are
+        returned with source < target, as by
+        `matrix_to_edges(include_reverse_edges=False)`.
+    seed : int
+        Random seed
+    as_array : bool
+        Whether to return a packed int32 array of shape (num_edges, 2) rather
+        than a list of tuples
+    n_jobs : int
+        Number of threads used to sort the edges. -1 uses all CPUs.
+
+    Returns
+    -------
+    edge_list : List[Tuple[int, int]] or numpy.ndarray
+        Generated edges, sorted by source and then target
+    """
+    import xswap._xswap_backend
+    if not bipartite and shape[0] != shape[1]:
+        raise ValueError("Unipartite networks need a square shape.")
+    edges = xswap._xswap_backend._generate_power_law_edges(
+        shape[0], shape[1], num_edges, exponent, bipartite, directed, seed,
+        _num_threads(n_jobs))
+    edges = numpy.frombuffer(edges, dtype=numpy.int32).reshape(-1, 2)
+    if as_array:
+        return edges
+    return list(map(tuple, edges.tolist()))
+
+
+def _num_threads(n_jobs):
+    """
+    Number of backend threads for `n_jobs`, where `-1` means all CPUs
+    """
+    if n_jobs == -1:
+        return os.cpu_count() or 1
+    if n_jobs < 1:
+        raise ValueError("n_jobs must be a positive integer or -1.")
+    return n_jobs
+
+
+def _edge_array(edges):
+    """
+    Return edges as a C-contiguous int32 array of shape (num_edges, 2), the
+    layout used by the backend. Arrays already in this layout are not copied.
+    """
+    edge_array = numpy.asarray(edges)
+    if edge_array.size == 0:
+        return numpy.zeros((0, 2), dtype=numpy.int32)
+    if edge_array.ndim != 2 or edge_array.shape[1] != 2:
+        raise ValueError("Edges must have shape (num_edges, 2).")
+    if edge_array.dtype != numpy.int32:
+        if not numpy.issubdtype(edge_array.dtype, numpy.integer):
+            raise ValueError("Edges must contain integer node ids.")
+        if edge_array.max() > numpy.iinfo(numpy.int32).max or edge_array.min() < 0:
+            raise ValueError("Node ids must be between 0 and 2_147_483_647.")
+    return numpy.ascontiguousarray(edge_array, dtype=numpy.int32)
+
+
+def _backend_edges(edge_list):
+    """
+    Check that edges contain no duplicates and return them in a form the
+    backend reads directly, along with the maximum node id. Lists of tuples are
+    returned as they are, and other inputs as packed int32 arrays.
+    """
+    if isinstance(edge_list, list):
+        if len(edge_list) != len(set(edge_list)):
+            raise ValueError("Edge list contained duplicate edges. "
+                             "XSwap does not support multigraphs.")
+        return edge_list, max(map(max, edge_list))
+    edge_array = _edge_array(edge_list)
+    # Sort edges as single 64-bit keys, which is much faster than unique rows
+    keys = (edge_array[:, 0].astype(numpy.int64) << 32) | edge_array[:, 1]
+    keys.sort()
+    if numpy.any(keys[1:] == keys[:-1]):
+        raise ValueError("Edge list contained duplicate edges. "
+                         "XSwap does not support multigraphs.")
+    return edge_array, int(edge_array.max())
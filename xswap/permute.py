@@ -1,10 +1,16 @@
-from typing import List, Set, Tuple
+import time
+from typing import Dict, List, Set, Tuple
+
+import numpy
+
+import xswap.network_formats
 
 
 def permute_edge_list(edge_list: List[Tuple[int, int]], allow_self_loops: bool = False,
                       allow_antiparallel: bool = False, multiplier: float = 10,
                       excluded_edges: Set[Tuple[int, int]] = set(), seed: int = 0,
-                      max_malloc: int = 4000000000):
+                      max_malloc: int = 4000000000, instrument: bool = False,
+                      hardware_counters: bool = False):
     """
     Permute the edges of a graph using the XSwap method given by Hanhijärvi,
     et al. (doi.org/f3mn58). XSwap is a degree-preserving network randomization
@@ -14,10 +20,12 @@ def permute_edge_list(edge_list: List[Tuple[int, int]], allow_self_loops: bool =
 
     Parameters
     ----------
-    edge_list : List[Tuple[int, int]]
+    edge_list : List[Tuple[int, int]] or numpy.ndarray
         Edge list representing the graph to be randomized. Tuples can contain
         integer values representing nodes. No value should be greater than C++'s
-        `INT_MAX`, in this case 2_147_483_647.
+        `INT_MAX`, in this case 2_147_483_647. An integer array of shape
+        (num_edges, 2), such as returned by `matrix_to_edges(as_array=True)`, is
+        passed to the backend without conversion to tuples.
     allow_self_loops : bool
         Whether to allow edges like (0, 0). In the case of bipartite graphs,
         such an edge represents a connection between two distinct nodes, while
@@ -44,11 +52,18 @@ def permute_edge_list(edge_list: List[Tuple[int, int]], allow_self_loops: bool =
         holding edges that is significantly faster than alternatives. However,
         it is memory-inefficient and will not be used if more memory is required
         than `max_malloc`. Above the threshold, a Roaring bitset will be used.
+    instrument : bool
+        Whether to time each phase of the permutation and add the timings and
+        memory use to `stats`, for diagnosing slow runs. Adds a few clock reads.
+    hardware_counters : bool
+        Whether to also count CPU cycles and cache misses during the swap loop,
+        using Linux perf events. Implies `instrument`.
 
     Returns
     -------
-    new_edges : List[Tuple[int, int]]
-        Edge list of a permutation of the network given as `edge_list`
+    new_edges : List[Tuple[int, int]] or numpy.ndarray
+        Edge list of a permutation of the network given as `edge_list`. When
+        `edge_list` is not a list, an int32 array of shape (num_edges, 2).
     stats : Dict[str, int]
         Information about the permutation performed. Gives the following information:
         `swap_attempts` - number of attempted swaps
@@ -58,19 +73,208 @@ def permute_edge_list(edge_list: List[Tuple[int, int]], allow_self_loops: bool =
         `undir_duplicate` - number of swaps rejected because the network is
             undirected and the reverse of the new edge already exists
         `excluded` - number of swaps rejected because new edge was among excluded
+        With `instrument`, also:
+        `accepted_swaps` - number of swaps performed
+        `backend` - edge membership bitset used, 'uncompressed' or 'roaring'
+        `bitset_bytes` - bytes allocated for the bitset
+        `edge_bytes` - bytes allocated for the edges being permuted
+        `validation_seconds` - time to check `edge_list` and find its maximum node ID
+        `input_conversion_seconds` - time to load the edges into the backend
+        `bitset_seconds` - time to build the bitset
+        `swap_seconds` - time of the swap loop
+        `output_conversion_seconds` - time to convert the permuted edges back
+        With `hardware_counters`, also `cycles` and `cache_misses` of the swap
+        loop, or None where perf events are unavailable.
     """
     import xswap._xswap_backend
-    if len(edge_list) != len(set(edge_list)):
-        raise ValueError("Edge list contained duplicate edges.")
+    instrument = instrument or hardware_counters
+    start = time.perf_counter()
+    # Also computes the maximum node ID (for creating the bitset)
+    edge_list, max_id = xswap.network_formats._backend_edges(edge_list)
+    validation_seconds = time.perf_counter() - start
 
     # Number of attempted XSwap swaps
     num_swaps = int(multiplier * len(edge_list))
 
-    # Compute the maximum node ID (for creating the bitset)
-    max_id = max(map(max, edge_list))
-
     new_edges, stats = xswap._xswap_backend._xswap(
         edge_list, list(excluded_edges), max_id, allow_self_loops,
-        allow_antiparallel, num_swaps, seed, max_malloc)
+        allow_antiparallel, num_swaps, seed, max_malloc, instrument, hardware_counters)
+    if instrument:
+        stats['validation_seconds'] = validation_seconds
+
+    if not isinstance(edge_list, list):
+        new_edges = numpy.frombuffer(new_edges, dtype=numpy.int32).reshape(-1, 2)
+    return new_edges, stats
+
+
+def permute_edge_file(input_path, output_path=None, allow_self_loops: bool = False,
+                      allow_antiparallel: bool = False, multiplier: float = 10,
+                      excluded_edges: Set[Tuple[int, int]] = set(), seed: int = 0,
+                      max_malloc: int = 4000000000):
+    """
+    Permute a binary edge file written by
+    `xswap.preprocessing.write_edges(binary=True)`. The file is memory-mapped
+    privately and its edges are swapped in place, without parsing or building
+    Python objects, so the file itself is never modified.
+
+    Parameters
+    ----------
+    input_path : str or pathlib.Path
+        Binary edge file containing the network to be randomized
+    output_path : str or pathlib.Path or None
+        If given, the permuted network is written to this path as a binary edge
+        file with the same header fields. Otherwise, it is returned as an array.
+    allow_self_loops, allow_antiparallel, multiplier, excluded_edges, seed, max_malloc
+        See `permute_edge_list`
 
+    Returns
+    -------
+    new_edges : numpy.ndarray or None
+        int32 array of shape (num_edges, 2) of the permuted edges, or None if
+        they were written to `output_path`
+    stats : Dict[str, int]
+        See `permute_edge_list`
+    """
+    import xswap._xswap_backend
+    import xswap.preprocessing
+    header = xswap.preprocessing.read_binary_header(input_path)
+    num_swaps = int(multiplier * header['num_edges'])
+
+    new_edges, stats = xswap._xswap_backend._xswap_file(
+        str(input_path), None if output_path is None else str(output_path),
+        list(excluded_edges), allow_self_loops, allow_antiparallel, num_swaps,
+        seed, max_malloc)
+
+    if new_edges is not None:
+        new_edges = numpy.frombuffer(new_edges, dtype=numpy.int32).reshape(-1, 2)
     return new_edges, stats
+
+
+_METAEDGE_OPTIONS = {
+    'allow_self_loops', 'allow_antiparallel', 'multiplier', 'excluded_edges', 'seed',
+}
+
+
+def permute_hetnet(metaedges: Dict[str, Dict], multiplier: float = 10, seed: int = 0,
+                   max_malloc: int = 4000000000, n_jobs: int = 1):
+    """
+    Permute every metaedge of a heterogeneous network in one call. Metaedges
+    are permuted in the backend on a shared pool of threads, largest first,
+    so that the largest ones start immediately and the smaller ones fill the
+    other threads. Each metaedge is permuted exactly as by `permute_edge_list`
+    with the same arguments, whatever the number of threads.
+
+    Parameters
+    ----------
+    metaedges : Dict[str, Dict]
+        Maps each metaedge name to its edge list, or to a dict with the edge
+        list under 'edges' and any of 'allow_self_loops', 'allow_antiparallel',
+        'excluded_edges', 'multiplier' and 'seed' as for `permute_edge_list`.
+        See README.md for the flags to use for bipartite, directed and
+        undirected metaedges. Unspecified flags take the defaults of
+        `permute_edge_list`.
+    multiplier, seed : float, int
+        Defaults for metaedges that do not specify them
+    max_malloc : int
+        See `permute_edge_list`. Applies to the bitset of each metaedge, and
+        one bitset is held per running thread.
+    n_jobs : int
+        Number of threads. -1 uses all CPUs.
+
+    Returns
+    -------
+    permuted : Dict[str, List[Tuple[int, int]] or numpy.ndarray]
+        Permuted edges of each metaedge, in the order of `metaedges` and in
+        the form returned by `permute_edge_list`
+    stats : Dict[str, Dict[str, int]]
+        Statistics of each metaedge, as returned by `permute_edge_list`
+    """
+    import xswap._xswap_backend
+    names = list(metaedges)
+    networks = list()
+    for name in names:
+        options = metaedges[name]
+        if not isinstance(options, dict):
+            options = {'edges': options}
+        unknown = set(options) - _METAEDGE_OPTIONS - {'edges'}
+        if unknown:
+            raise ValueError('Unknown options for metaedge {}: {}'.format(
+                name, ', '.join(sorted(unknown))))
+        edge_list, max_id = xswap.network_formats._backend_edges(options['edges'])
+        num_swaps = int(options.get('multiplier', multiplier) * len(edge_list))
+        networks.append((
+            edge_list, list(options.get('excluded_edges', set())), max_id,
+            options.get('allow_self_loops', False), options.get('allow_antiparallel', False),
+            num_swaps, options.get('seed', seed),
+        ))
+
+    results = xswap._xswap_backend._xswap_networks(
+        networks, max_malloc, xswap.network_formats._num_threads(n_jobs))
+
+    permuted = dict()
+    stats = dict()
+    for name, network, (new_edges, network_stats) in zip(names, networks, results):
+        if not isinstance(network[0], list):
+            new_edges = numpy.frombuffer(new_edges, dtype=numpy.int32).reshape(-1, 2)
+        permuted[name] = new_edges
+        stats[name] = network_stats
+    return permuted, stats
+
+
+def write_permutations(edge_list: List[Tuple[int, int]], path, n_permutations: int,
+                       output_format: str = 'text', allow_self_loops: bool = False,
+                       allow_antiparallel: bool = False, multiplier: float = 10,
+                       excluded_edges: Set[Tuple[int, int]] = set(), seed: int = 0,
+                       max_malloc: int = 4000000000, background_io: bool = True,
+                       node_delim: str = ',', edge_delim: str = '\n', n_jobs: int = 1):
+    """
+    Permute a network `n_permutations` times and write each permutation to disk
+    directly from the backend's edge buffer, without creating Python objects.
+    Permutation `i` uses seed `seed + i`, as in `xswap.prior`, so any one of
+    them can be reproduced with `permute_edge_list`.
+
+    Parameters
+    ----------
+    edge_list : List[Tuple[int, int]] or numpy.ndarray
+        Edge list representing the graph to be randomized
+    path : str or pathlib.Path
+        For the 'text' and 'binary' formats, the path of each permutation's
+        file, where "{}" is replaced by the permutation index, such as
+        'permutations/{}.csv'. For the 'ensemble' format, the path of the
+        single ensemble file.
+    n_permutations : int
+        Number of permutations
+    output_format : str
+        'text' for delimited files like `xswap.preprocessing.write_edges`,
+        'binary' for binary edge files, or 'ensemble' for one file read by
+        `xswap.preprocessing.PermutationEnsemble`
+    allow_self_loops, allow_antiparallel, multiplier, excluded_edges, seed, max_malloc
+        See `permute_edge_list`
+    background_io : bool
+        Whether to write each permutation on a background thread while the
+        next one is being swapped
+    node_delim, edge_delim : str
+        Delimiters for the 'text' format
+    n_jobs : int
+        Number of threads permuting at once, each with its own copy of the
+        edges and its own bitset of up to `max_malloc` bytes. Outputs do not
+        depend on the number of threads. -1 uses all CPUs.
+
+    Returns
+    -------
+    stats : List[Dict[str, int]]
+        Statistics of each permutation, as returned by `permute_edge_list`
+    """
+    import xswap._xswap_backend
+    if n_permutations < 0:
+        raise ValueError("n_permutations must be non-negative.")
+    edge_list, max_id = xswap.network_formats._backend_edges(edge_list)
+    num_swaps = int(multiplier * len(edge_list))
+    if output_format != 'ensemble' and n_permutations > 1 and '{}' not in str(path):
+        raise ValueError('path must contain "{}" to write several permutations.')
+
+    return xswap._xswap_backend._xswap_write(
+        edge_list, list(excluded_edges), max_id, allow_self_loops,
+        allow_antiparallel, num_swaps, seed, n_permutations, max_malloc,
+        str(path), output_format, node_delim, edge_delim, background_io,
+        xswap.network_formats._num_threads(n_jobs))
@@ -1,4 +1,9 @@
 import csv
+import struct
+
+import numpy
+
+import xswap.network_formats
 
 
 def load_str_edges(filename, node_delim=',', edge_delim='\n'):
@@ -12,24 +17,177 @@ def load_str_edges(filename, node_delim=',', edge_delim='\n'):
     return str_edges
 
 
-def load_processed_edges(filename):
+def load_processed_edges(filename, node_delim=',', edge_delim='\n',
+                         as_array=False, n_jobs=1):
     """
     Load processed edges from a file. Processed means that edges are guaranteed
     to be integers ranging from zero to the number of unique nodes.
+
+    The file is memory-mapped and parsed natively, in parallel chunks split at
+    edge delimiters when `n_jobs` is greater than one. As with
+    `load_str_edges`, lines with a single field are skipped and fields after
+    the second are ignored. Raises a `ValueError` naming the line of the first
+    edge that is not a pair of non-negative integers. Binary edge files from
+    `write_edges(binary=True)` are recognized by their header and loaded
+    without parsing, after verifying their checksum.
+
+    Returns a list of `Tuple[int, int]`, or with `as_array=True`, an int32
+    array of shape (num_edges, 2) that the permutation and prior functions
+    read without conversion. `n_jobs=-1` uses all CPUs.
     """
-    str_edges = load_str_edges(filename)
-    edges = [
-        (int(edge[0]), int(edge[1])) for edge in str_edges
-    ]
-    return edges
+    import xswap._xswap_backend
+    packed_edges = xswap._xswap_backend._load_edge_file(
+        str(filename), node_delim, edge_delim, xswap.network_formats._num_threads(n_jobs))
+    edges = numpy.frombuffer(packed_edges, dtype=numpy.int32).reshape(-1, 2)
+    if as_array:
+        return edges
+    return list(map(tuple, edges.tolist()))
+
 
+# Header of binary edge files, matching `EdgeFileHeader` in xswap/src/xswap.h
+_BINARY_HEADER = struct.Struct('=8sIIQiiQ24x')
+_BINARY_MAGIC = b'XSWAPEDG'
 
-def write_edges(filename, edges, node_delim=',', edge_delim='\n'):
+
+def write_edges(filename, edges, node_delim=',', edge_delim='\n', binary=False,
+                directed=False, bipartite=False):
+    """
+    Write edges to a delimited text file, or with `binary=True`, to a binary
+    edge file that `load_processed_edges` and `permute_edge_file` read without
+    parsing. Binary files hold a header with the number of edges, the largest
+    source and target ids, the `directed` and `bipartite` flags and a
+    checksum, followed by the packed int32 edges. Edges written to a binary
+    file must be unique non-negative integers.
+    """
+    if binary:
+        import xswap._xswap_backend
+        edge_array, _ = xswap.network_formats._backend_edges(
+            xswap.network_formats._edge_array(edges))
+        flags = (1 if directed else 0) | (2 if bipartite else 0)
+        xswap._xswap_backend._write_edge_file(str(filename), edge_array, flags)
+        return
     with open(filename, 'w', newline='') as f:
         writer = csv.writer(f, delimiter=node_delim, lineterminator=edge_delim)
         writer.writerows(edges)
 
 
+def read_binary_header(filename):
+    """
+    Read the header of a binary edge file written by `write_edges`.
+
+    Returns:
+    --------
+    Dict with `num_edges`, `max_source_id`, `max_target_id` (-1 when there are
+    no edges), `directed`, `bipartite` and `checksum`
+    """
+    with open(filename, 'rb') as f:
+        data = f.read(_BINARY_HEADER.size)
+    if len(data) < _BINARY_HEADER.size or data[:8] != _BINARY_MAGIC:
+        raise ValueError("{} is not a binary edge file.".format(filename))
+    (_, version, flags, num_edges, max_source_id, max_target_id,
+     checksum) = _BINARY_HEADER.unpack(data)
+    if version != 1:
+        raise ValueError("Unsupported binary edge file version {}.".format(version))
+    return {
+        'num_edges': num_edges,
+        'max_source_id': max_source_id,
+        'max_target_id': max_target_id,
+        'directed': bool(flags & 1),
+        'bipartite': bool(flags & 2),
+        'checksum': checksum,
+    }
+
+
+def write_ensemble(filename, edges, permutations=()):
+    """
+    Create a permutation ensemble file holding `edges` and the given
+    permutations of them. XSwap moves only targets, so each permutation is
+    stored as its targets' differences from the original targets, as varints
+    with runs of unchanged targets collapsed. Permutations are typically an
+    order of magnitude smaller than as text, and are read back individually by
+    `PermutationEnsemble`.
+
+    edges : List[Tuple[int, int]] or numpy.ndarray
+        Original edges
+    permutations : Iterable of edge lists or arrays
+        Permutations of `edges`, with sources in the same order, as returned by
+        `permute_edge_list`
+    """
+    import xswap._xswap_backend
+    xswap._xswap_backend._create_ensemble(
+        str(filename), xswap.network_formats._edge_array(edges))
+    append_to_ensemble(filename, permutations)
+
+
+def append_to_ensemble(filename, permutations, batch_size=32):
+    """
+    Append permutations to an ensemble file created by `write_ensemble`,
+    encoding `batch_size` permutations per call to the backend. Returns the
+    number of permutations in the file.
+    """
+    import xswap._xswap_backend
+    num_permutations = len(PermutationEnsemble(filename))
+    batch = []
+    for permutation in permutations:
+        batch.append(xswap.network_formats._edge_array(permutation))
+        if len(batch) == batch_size:
+            num_permutations = xswap._xswap_backend._append_ensemble(
+                str(filename), numpy.ascontiguousarray(numpy.stack(batch)))
+            batch = []
+    if batch:
+        num_permutations = xswap._xswap_backend._append_ensemble(
+            str(filename), numpy.ascontiguousarray(numpy.stack(batch)))
+    return num_permutations
+
+
+class PermutationEnsemble:
+    """
+    Random access to the permutations in an ensemble file written by
+    `write_ensemble`. The file is mapped and its blocks indexed once, when the
+    ensemble is opened, so permutations appended later are not seen. Indexing
+    decodes a single permutation into an int32 array of shape (num_edges, 2),
+    after verifying its checksum.
+
+    Example
+    -------
+    >>> ensemble = PermutationEnsemble('permutations.xswap')
+    >>> len(ensemble)
+    1000
+    >>> ensemble[10]
+    """
+    def __init__(self, filename):
+        import xswap._xswap_backend
+        self.filename = str(filename)
+        (self._reader, self.num_edges, self.num_permutations, self.max_source_id,
+         self.max_target_id) = xswap._xswap_backend._open_ensemble(self.filename)
+
+    def __len__(self):
+        return self.num_permutations
+
+    def __getitem__(self, index):
+        if index < 0:
+            index += self.num_permutations
+        if not 0 <= index < self.num_permutations:
+            raise IndexError("Permutation index is out of range.")
+        return self._read(index)
+
+    def __iter__(self):
+        for index in range(self.num_permutations):
+            yield self._read(index)
+
+    @property
+    def edges(self):
+        """
+        Original edges of the ensemble
+        """
+        return self._read(-1)
+
+    def _read(self, index):
+        import xswap._xswap_backend
+        edges = xswap._xswap_backend._read_ensemble(self._reader, index)
+        return numpy.frombuffer(edges, dtype=numpy.int32).reshape(-1, 2)
+
+
 def write_mapping(filename, mapping, delimiter=','):
     with open(filename, 'w', newline='') as f:
         writer = csv.writer(f, delimiter=delimiter)
@@ -69,7 +227,7 @@ def _apply_map(edges, source_mapping, target_mapping):
     return list(zip(*mapped_nodes))
 
 
-def map_str_edges(edges, bipartite):
+def map_str_edges(edges, bipartite, as_array=False, n_jobs=1):
     """
     Maps a list of edge tuples containing strings to a minimal set of
     integer edges.
@@ -82,6 +240,16 @@ def map_str_edges(edges, bipartite):
         edge would be mapped like (0, 1), where the new node ids reflect the fact
         that the same names do not indicate the same nodes. To ensure that names
         are consistently mapped between source and target, put `bipartite=False`.
+    as_array : bool
+        Whether to return mapped edges as an int32 array of shape (num_edges, 2)
+        rather than a list of tuples.
+    n_jobs : int
+        Number of threads for sorting names and relabeling edges. `-1` uses
+        all CPUs.
+
+    Names are interned and sorted natively, with the same sorted id assignment
+    as sorting the names in Python. Edges containing names that are not `str`
+    are mapped in Python.
 
     Returns:
     --------
@@ -93,6 +261,31 @@ def map_str_edges(edges, bipartite):
 
     ([(0, 1), (1, 2)], {0: 'a', 1: 'b', 2: 'c'})
     """
+    import xswap._xswap_backend
+    try:
+        mapped_edges, source_names, target_names = xswap._xswap_backend._map_str_edges(
+            edges, bipartite, xswap.network_formats._num_threads(n_jobs), not as_array)
+    except (TypeError, UnicodeEncodeError):
+        mapped_edges, source_map, target_map = _map_str_edges_python(edges, bipartite)
+        if as_array:
+            mapped_edges = numpy.array(mapped_edges, dtype=numpy.int32).reshape(-1, 2)
+        return (mapped_edges, source_map, target_map)
+
+    source_map = {name: i for i, name in enumerate(source_names)}
+    if bipartite:
+        target_map = {name: i for i, name in enumerate(target_names)}
+    else:
+        target_map = source_map
+
+    if as_array:
+        mapped_edges = numpy.frombuffer(mapped_edges, dtype=numpy.int32).reshape(-1, 2)
+    return (mapped_edges, source_map, target_map)
+
+
+def _map_str_edges_python(edges, bipartite):
+    """
+    Python implementation of `map_str_edges`, used for names that are not `str`
+    """
     source_nodes = [edge[0] for edge in edges]
     target_nodes = [edge[1] for edge in edges]
 
@@ -1,8 +1,10 @@
-from typing import List, Tuple
+import collections
+from typing import Dict, List, Tuple
 
 import numpy
 import pandas
 import scipy.sparse
+import scipy.stats
 
 import xswap.network_formats
 
@@ -15,7 +17,8 @@ def compute_xswap_occurrence_matrix(edge_list: List[Tuple[int, int]],
                                     sparse: bool = True,
                                     swap_multiplier: float = 10,
                                     initial_seed: int = 0,
-                                    max_malloc: int = 4000000000):
+                                    max_malloc: int = 4000000000,
+                                    n_jobs: int = 1):
     """
     Compute the XSwap prior probability for every node pair in a network. The
     XSwap prior is the probability of a node pair having an edge between them in
@@ -48,9 +51,9 @@ def compute_xswap_occurrence_matrix(edge_list: List[Tuple[int, int]],
         distinct nodes, while for other graphs, these may be connections between
         the same two nodes.
     sparse : bool
-        Whether to use a sparse matrix when adding up edge occurrences across
-        permutations. If large changes in sparsity are expected, a dense
-        array may be preferable.
+        Whether to count edge occurrences in a hash of node pairs and return a
+        sparse matrix, or in a dense array. If large changes in sparsity are
+        expected, a dense array may be preferable.
     swap_multiplier : float
         The number of edge swap attempts is determined by the product of the
         number of existing edges and multiplier. For example, if five edges are
@@ -68,35 +71,42 @@ def compute_xswap_occurrence_matrix(edge_list: List[Tuple[int, int]],
         holding edges that is significantly faster than alternatives. However,
         it is memory-inefficient and will not be used if more memory is required
         than `max_malloc`. Above the threshold, a Roaring bitset will be used.
+    n_jobs : int
+        The number of threads running permutations. Each thread runs a
+        contiguous range of seeds into private counts, which are then summed,
+        so results are identical for any `n_jobs`. `-1` uses all available
+        CPUs. Each thread allocates its own edge bitset of up to `max_malloc`
+        bytes. With `sparse=False`, each thread other than the first also
+        counts into its own dense matrix if the matrix fits in `max_malloc`
+        bytes, and into a hash of node pairs otherwise.
 
     Returns
     -------
-    edge_counter : scipy.sparse.csc_matrix
+    edge_counter : scipy.sparse.csc_matrix or numpy.ndarray
         Adjacency matrix with entries equal to the number of permutations in
         which a given edge appeared
     """
     import xswap._xswap_backend
-    if len(edge_list) != len(set(edge_list)):
-        raise ValueError("Edge list contained duplicate edges. "
-                         "XSwap does not support multigraphs.")
-
+    edge_list, max_id = xswap.network_formats._backend_edges(edge_list)
     num_swaps = int(swap_multiplier * len(edge_list))
 
-    max_id = max(map(max, edge_list))
+    # Occurrences are counted in the backend, without converting permutations
+    counts = xswap._xswap_backend._xswap_occurrence(
+        edge_list, max_id, allow_self_loops, allow_antiparallel, num_swaps,
+        initial_seed, n_permutations, max_malloc, shape[0], shape[1], sparse,
+        xswap.network_formats._num_threads(n_jobs))
 
     if sparse:
-        edge_counter = scipy.sparse.csc_matrix(shape, dtype=int)
+        rows, cols, values = counts
+        edge_counter = scipy.sparse.csc_matrix(
+            (numpy.frombuffer(values, dtype=numpy.int64),
+             (numpy.frombuffer(rows, dtype=numpy.int32),
+              numpy.frombuffer(cols, dtype=numpy.int32))),
+            shape=shape, dtype=int)
     else:
-        edge_counter = numpy.zeros(shape, dtype=int)
-
-    for i in range(n_permutations):
-        permuted_edges, stats = xswap._xswap_backend._xswap(
-            edge_list, [], max_id, allow_self_loops, allow_antiparallel,
-            num_swaps, initial_seed + i, max_malloc)
-        permuted_matrix = xswap.network_formats.edges_to_matrix(
-            permuted_edges, add_reverse_edges=(not allow_antiparallel),
-            shape=shape, dtype=int, sparse=sparse)
-        edge_counter += permuted_matrix
+        edge_counter = (numpy.frombuffer(counts, dtype=numpy.int64)
+                        .reshape(shape)
+                        .astype(int, copy=False))
 
     return edge_counter
 
@@ -108,6 +118,7 @@ def compute_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
                          max_malloc: int = 4000000000,
                          dtypes = {'id': numpy.uint16, 'degree': numpy.uint16,
                                    'edge': bool, 'xswap_prior': float},
+                         n_jobs: int = 1,
                         ):
     """
     Compute the XSwap prior for every potential edge in the network. Uses
@@ -116,7 +127,9 @@ def compute_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
     be grouped when computing the XSwap prior, allowing there to be more
     permutations for some node pairs than `n_permutations`.
 
-    Note that the mechanics of this function are separated to minimize memory use.
+    Edges are counted by degree pair in the backend (see
+    `compute_xswap_degree_priors`), so only the returned DataFrame scales with
+    the number of node pairs.
 
     Parameters
     ----------
@@ -143,9 +156,8 @@ def compute_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
         distinct nodes, while for other graphs, these may be connections between
         the same two nodes.
     sparse : bool
-        Whether to use a sparse matrix when adding up edge occurrences across
-        permutations. If large changes in sparsity are expected, a dense
-        array may be preferable.
+        Unused. Edge occurrences are counted by degree pair in the backend, so
+        no occurrence matrix is built. Kept for backward compatibility.
     swap_multiplier : float
         The number of edge swap attempts is determined by the product of the
         number of existing edges and multiplier. For example, if five edges are
@@ -169,6 +181,9 @@ def compute_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
         be changed from its defaults if the values of `id` or `degree` are
         greater than the maxima in the default dtypes, or in cases where greater
         precision is desired. (`numpy.uint16` has a maximum value of 65535.)
+    n_jobs : int
+        See `compute_xswap_occurrence_matrix`. Degree-pair counts are small, so
+        each thread adds only its own edge bitset.
 
     Returns
     -------
@@ -176,75 +191,538 @@ def compute_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
         Columns are the following:
         [source_id, target_id, edge, source_degree, target_degree, xswap_prior]
     """
+    prior_inputs = _prepare_priors(
+        edge_list, n_permutations, shape, allow_self_loops=allow_self_loops,
+        allow_antiparallel=allow_antiparallel, swap_multiplier=swap_multiplier,
+        initial_seed=initial_seed, max_malloc=max_malloc, dtypes=dtypes,
+        n_jobs=n_jobs)
+    return _prior_block(prior_inputs, 0, shape[0], dtypes)
+
+
+def iter_xswap_priors(edge_list: List[Tuple[int, int]], n_permutations: int,
+                      shape: Tuple[int, int], allow_self_loops: bool = False,
+                      allow_antiparallel: bool = False, swap_multiplier: int = 10,
+                      initial_seed: int = 0, max_malloc: int = 4000000000,
+                      dtypes = {'id': numpy.uint16, 'degree': numpy.uint16,
+                                'edge': bool, 'xswap_prior': float},
+                      n_jobs: int = 1, block_size: int = 1000):
+    """
+    Generate the DataFrame of `compute_xswap_priors` in blocks of source nodes.
+    Permutations are run once, before the first block is yielded. Each block is
+    then filled from the degree-pair prior table, so peak memory is bounded by
+    `block_size * shape[1]` rows rather than `shape[0] * shape[1]`.
+
+    Parameters
+    ----------
+    edge_list, n_permutations, shape, allow_self_loops, allow_antiparallel,
+    swap_multiplier, initial_seed, max_malloc, dtypes, n_jobs
+        See `compute_xswap_priors`
+    block_size : int
+        The number of source nodes (matrix rows) in each yielded DataFrame
+
+    Yields
+    ------
+    prior_df : pandas.DataFrame
+        Rows of `compute_xswap_priors` for source nodes `i * block_size` up to
+        `(i + 1) * block_size`, with the same columns and index. Concatenating
+        all blocks gives the full DataFrame.
+    """
+    if block_size < 1:
+        raise ValueError("block_size must be a positive integer.")
+    prior_inputs = _prepare_priors(
+        edge_list, n_permutations, shape, allow_self_loops=allow_self_loops,
+        allow_antiparallel=allow_antiparallel, swap_multiplier=swap_multiplier,
+        initial_seed=initial_seed, max_malloc=max_malloc, dtypes=dtypes,
+        n_jobs=n_jobs)
+    for row_start in range(0, shape[0], block_size):
+        row_end = min(row_start + block_size, shape[0])
+        yield _prior_block(prior_inputs, row_start, row_end, dtypes)
+
+
+_PriorInputs = collections.namedtuple('_PriorInputs', [
+    'original_edges', 'source_degrees', 'target_degrees', 'source_index',
+    'target_index', 'prior_table'])
+
+
+def _prepare_priors(edge_list, n_permutations, shape, allow_self_loops,
+                    allow_antiparallel, swap_multiplier, initial_seed,
+                    max_malloc, dtypes, n_jobs):
+    """
+    Run the permutations and gather what is needed to fill any block of rows
+    of the per-pair prior DataFrame
+    """
     # Compute the adjacency matrix of the original (unpermuted) network
     original_edges = xswap.network_formats.edges_to_matrix(
         edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
-        dtype=dtypes['edge'], sparse=True)
+        dtype=dtypes['edge'], sparse=True).tocsr()
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
+
+    # Degree-grouped prior for every (source_degree, target_degree) pair
+    degree_prior_df = _degree_pair_priors(
+        edge_list, source_degrees, target_degrees, n_permutations,
+        allow_self_loops=allow_self_loops, allow_antiparallel=allow_antiparallel,
+        swap_multiplier=swap_multiplier, initial_seed=initial_seed,
+        max_malloc=max_malloc, n_jobs=n_jobs)
+
+    # Position of each node's degree in the degree-pair table
+    source_values = degree_prior_df['source_degree'].unique()
+    target_values = degree_prior_df['target_degree'].unique()
+    return _PriorInputs(
+        original_edges=original_edges,
+        source_degrees=source_degrees,
+        target_degrees=target_degrees,
+        source_index=numpy.searchsorted(source_values, source_degrees).astype(numpy.int32),
+        target_index=numpy.searchsorted(target_values, target_degrees).astype(numpy.int32),
+        prior_table=numpy.ascontiguousarray(degree_prior_df['xswap_prior'].values,
+                                            dtype=numpy.float64),
+    )
+
+
+def _prior_block(prior_inputs, row_start, row_end, dtypes):
+    """
+    Per-pair prior DataFrame for source nodes `row_start` to `row_end`
+    """
+    import xswap._xswap_backend
+    num_rows = row_end - row_start
+    num_cols = len(prior_inputs.target_degrees)
+    num_target_values = int(prior_inputs.target_index.max()) + 1 if num_cols else 0
+    xswap_prior = numpy.frombuffer(xswap._xswap_backend._scatter_degree_pairs(
+        prior_inputs.prior_table, num_target_values, prior_inputs.source_index,
+        prior_inputs.target_index, row_start, row_end), dtype=numpy.float64)
 
-    # Setup DataFrame for recording prior data
     prior_df = pandas.DataFrame({
-        'source_id': numpy.repeat(numpy.arange(shape[0], dtype=dtypes['id']), shape[1]),
-        'target_id': numpy.tile(numpy.arange(shape[1], dtype=dtypes['id']), shape[0]),
-        'edge': original_edges.toarray().flatten(),
-    })
+        'source_id': numpy.repeat(numpy.arange(row_start, row_end, dtype=dtypes['id']), num_cols),
+        'target_id': numpy.tile(numpy.arange(num_cols, dtype=dtypes['id']), num_rows),
+        'edge': prior_inputs.original_edges[row_start:row_end].toarray().flatten(),
+        'source_degree': numpy.repeat(
+            prior_inputs.source_degrees[row_start:row_end].astype(dtypes['degree']), num_cols),
+        'target_degree': numpy.tile(prior_inputs.target_degrees.astype(dtypes['degree']), num_rows),
+        'xswap_prior': xswap_prior.astype(dtypes['xswap_prior']),
+    }, index=pandas.RangeIndex(row_start * num_cols, row_end * num_cols))
+    return prior_df
+
+
+def compute_xswap_degree_priors(edge_list: List[Tuple[int, int]],
+                                n_permutations: int, shape: Tuple[int, int],
+                                allow_self_loops: bool = False,
+                                allow_antiparallel: bool = False,
+                                swap_multiplier: float = 10, initial_seed: int = 0,
+                                max_malloc: int = 4000000000, n_jobs: int = 1):
+    """
+    Compute the degree-grouped XSwap prior for every pair of source and target
+    degrees. This is the prior used by `compute_xswap_priors`, but edges are
+    tallied by degree pair in the backend, so memory is proportional to the
+    number of nodes and distinct degree pairs rather than to the number of
+    node pairs.
+
+    Parameters
+    ----------
+    edge_list : List[Tuple[int, int]]
+        Edge list representing the graph whose XSwap edge priors are to be
+        computed. Tuples contain integer values representing nodes. No value
+        should be greater than C++'s `INT_MAX`, in this case 2_147_483_647.
+    n_permutations : int
+        The number of permuted networks used to compute the empirical XSwap prior
+    shape : Tuple[int, int]
+        The shape of the (bi)adjacency matrix. In other words, a tuple of the
+        number of source and target nodes.
+    allow_self_loops : bool
+        Whether to allow edges like (0, 0).
+    allow_antiparallel : bool
+        Whether to allow simultaneous edges like (0, 1) and (1, 0).
+    swap_multiplier : float
+        The number of edge swap attempts is determined by the product of the
+        number of existing edges and multiplier.
+    initial_seed : int
+        Random seed used for the first permutation. Each subsequent permutation
+        increments the seed by one.
+    max_malloc : int (`unsigned long long int` in C)
+        The maximum amount of memory to be allocated using `malloc` when making
+        a bitset to hold edges. Above the threshold, a Roaring bitset will be used.
+    n_jobs : int
+        See `compute_xswap_occurrence_matrix`. Degree-pair counts are small, so
+        each thread adds only its own edge bitset.
+
+    Returns
+    -------
+    degree_prior_df : pandas.DataFrame
+        One row per (source_degree, target_degree) pair, sorted by degrees.
+        Columns are the following:
+        [source_degree, target_degree, num_pairs, num_permuted_edges, xswap_prior]
+        where `num_pairs` is the number of node pairs with the given degrees and
+        `num_permuted_edges` is the number of edges between such node pairs
+        across all permutations.
+    """
+    original_edges = xswap.network_formats.edges_to_matrix(
+        edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
+        dtype=int, sparse=True)
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
     del original_edges
 
-    prior_df['source_degree'] = (prior_df
-                                 .groupby('source_id')
-                                 .transform(sum)['edge']
-                                 .astype(dtypes['degree']))
-    del prior_df['source_id']
-
-    prior_df['target_degree'] = (prior_df
-                                 .groupby('target_id')
-                                 .transform(sum)['edge']
-                                 .astype(dtypes['degree']))
-    del prior_df['target_id']
-
-    # Compute the number of occurrences of each edge across permutations
-    edge_counter = compute_xswap_occurrence_matrix(
-        edge_list=edge_list, n_permutations=n_permutations, shape=shape,
+    return _degree_pair_priors(
+        edge_list, source_degrees, target_degrees, n_permutations,
         allow_self_loops=allow_self_loops, allow_antiparallel=allow_antiparallel,
-        sparse=sparse, swap_multiplier=swap_multiplier, initial_seed=initial_seed,
-        max_malloc=max_malloc)
-
-    prior_df['num_permuted_edges'] = edge_counter.toarray().flatten()
-    del edge_counter
-
-    # The number of edges that occurred across all node pairs with the same
-    # `source_degree` and `target_degree`
-    dgp_edge_count = (
-        prior_df
-        .groupby(['source_degree', 'target_degree'])
-        .transform(sum)['num_permuted_edges']
-        .values
-        .astype(dtypes['degree'])
-    )
-    del prior_df['num_permuted_edges']
-
-    # The effective number of permutations for every node pair, incorporating
-    # degree-grouping
-    num_dgp = (
-        n_permutations * prior_df.groupby(['source_degree', 'target_degree'])
-                                 .transform(len)['edge']
-                                 .values
-    )
-    xswap_prior = (dgp_edge_count / num_dgp).astype(dtypes['xswap_prior'])
-    del dgp_edge_count, num_dgp
+        swap_multiplier=swap_multiplier, initial_seed=initial_seed,
+        max_malloc=max_malloc, n_jobs=n_jobs)
+
+
+_METAEDGE_PRIOR_OPTIONS = {'edges', 'shape', 'allow_self_loops', 'allow_antiparallel'}
+
+
+def iter_hetnet_degree_priors(metaedges: Dict[str, Dict], n_permutations: int,
+                              swap_multiplier: float = 10, initial_seed: int = 0,
+                              max_malloc: int = 4000000000, n_jobs: int = 1):
+    """
+    Generate the degree-pair prior table of `compute_xswap_degree_priors` for
+    each metaedge of a heterogeneous network. Metaedges are processed one at a
+    time, each with all `n_jobs` threads, and a metaedge's edges, bitsets and
+    counts are released before the next one starts. Peak memory is therefore
+    that of the largest metaedge rather than of the whole network.
+
+    Parameters
+    ----------
+    metaedges : Dict[str, Dict]
+        Maps each metaedge name to a dict with its edge list under 'edges', its
+        (bi)adjacency matrix shape under 'shape', and optionally
+        'allow_self_loops' and 'allow_antiparallel', as for
+        `compute_xswap_degree_priors`
+    n_permutations, swap_multiplier, initial_seed, max_malloc, n_jobs
+        See `compute_xswap_degree_priors`. These are shared by all metaedges.
+
+    Yields
+    ------
+    name : str
+        Metaedge name, in the order of `metaedges`
+    degree_prior_df : pandas.DataFrame
+        The table returned by `compute_xswap_degree_priors` for the metaedge
+    """
+    # Check every metaedge before running any permutations
+    for name, options in metaedges.items():
+        unknown = set(options) - _METAEDGE_PRIOR_OPTIONS
+        if unknown:
+            raise ValueError('Unknown options for metaedge {}: {}'.format(
+                name, ', '.join(sorted(unknown))))
+        if 'edges' not in options or 'shape' not in options:
+            raise ValueError('Metaedge {} needs edges and shape.'.format(name))
+
+    for name, options in metaedges.items():
+        degree_prior_df = compute_xswap_degree_priors(
+            options['edges'], n_permutations, options['shape'],
+            allow_self_loops=options.get('allow_self_loops', False),
+            allow_antiparallel=options.get('allow_antiparallel', False),
+            swap_multiplier=swap_multiplier, initial_seed=initial_seed,
+            max_malloc=max_malloc, n_jobs=n_jobs)
+        yield name, degree_prior_df
+
+
+def compute_hetnet_degree_priors(metaedges: Dict[str, Dict], n_permutations: int,
+                                 swap_multiplier: float = 10, initial_seed: int = 0,
+                                 max_malloc: int = 4000000000, n_jobs: int = 1):
+    """
+    Compute the degree-pair prior table of every metaedge of a heterogeneous
+    network in one call. See `iter_hetnet_degree_priors`, which this collects.
+    The tables have one row per degree pair, so they are small next to the
+    metaedges themselves.
 
-    prior_df['xswap_prior'] = xswap_prior
-    del xswap_prior
+    Returns
+    -------
+    degree_priors : Dict[str, pandas.DataFrame]
+        Degree-pair prior table of each metaedge, in the order of `metaedges`
+    """
+    return dict(iter_hetnet_degree_priors(
+        metaedges, n_permutations, swap_multiplier=swap_multiplier,
+        initial_seed=initial_seed, max_malloc=max_malloc, n_jobs=n_jobs))
+
+
+def _matrix_degrees(matrix):
+    """
+    Return the source (row) and target (column) degrees of a sparse
+    (bi)adjacency matrix as int32 arrays.
+    """
+    source_degrees = numpy.asarray(matrix.sum(axis=1, dtype=int)).flatten()
+    target_degrees = numpy.asarray(matrix.sum(axis=0, dtype=int)).flatten()
+    return source_degrees.astype(numpy.int32), target_degrees.astype(numpy.int32)
+
+
+def _degree_pair_priors(edge_list, source_degrees, target_degrees,
+                        n_permutations, allow_self_loops, allow_antiparallel,
+                        swap_multiplier, initial_seed, max_malloc, n_jobs):
+    """
+    Count permuted edges by (source_degree, target_degree) in the backend and
+    return the degree-pair prior table described in
+    `compute_xswap_degree_priors`.
+    """
+    import xswap._xswap_backend
+    edge_list, max_id = xswap.network_formats._backend_edges(edge_list)
+    num_swaps = int(swap_multiplier * len(edge_list))
+
+    (source_values, target_values, source_nodes, target_nodes, counts,
+     squared_counts) = xswap._xswap_backend._xswap_degree_counts(
+        edge_list, max_id, allow_self_loops, allow_antiparallel, num_swaps,
+        initial_seed, n_permutations, max_malloc,
+        numpy.ascontiguousarray(source_degrees, dtype=numpy.int32),
+        numpy.ascontiguousarray(target_degrees, dtype=numpy.int32),
+        xswap.network_formats._num_threads(n_jobs))
+
+    return _degree_pair_table(source_values, target_values, source_nodes,
+                              target_nodes, counts, n_permutations)
+
+
+def _degree_pair_table(source_values, target_values, source_nodes, target_nodes,
+                       counts, n_permutations):
+    """
+    Build the degree-pair prior table from the buffers returned by the backend
+    """
+    source_values = numpy.frombuffer(source_values, dtype=numpy.int32)
+    target_values = numpy.frombuffer(target_values, dtype=numpy.int32)
+    num_pairs = numpy.outer(numpy.frombuffer(source_nodes, dtype=numpy.int64),
+                            numpy.frombuffer(target_nodes, dtype=numpy.int64))
+    counts = numpy.frombuffer(counts, dtype=numpy.int64)
 
-    prior_df = (
-        prior_df
-        .assign(
-            source_id=numpy.repeat(numpy.arange(shape[0], dtype=dtypes['id']), shape[1]),
-            target_id=numpy.tile(numpy.arange(shape[1], dtype=dtypes['id']), shape[0]),
+    degree_prior_df = pandas.DataFrame({
+        'source_degree': numpy.repeat(source_values, len(target_values)),
+        'target_degree': numpy.tile(target_values, len(source_values)),
+        'num_pairs': num_pairs.flatten(),
+        'num_permuted_edges': counts,
+    })
+    with numpy.errstate(divide='ignore', invalid='ignore'):
+        degree_prior_df['xswap_prior'] = (
+            degree_prior_df['num_permuted_edges']
+            / (n_permutations * degree_prior_df['num_pairs'])
         )
-        .filter(items=['source_id', 'target_id', 'edge', 'source_degree',
-                       'target_degree', 'xswap_prior'])
-    )
-    return prior_df
+    return degree_prior_df
+
+
+def compute_xswap_query_priors(edge_list: List[Tuple[int, int]], query_pairs,
+                               n_permutations: int, shape: Tuple[int, int],
+                               allow_self_loops: bool = False,
+                               allow_antiparallel: bool = False,
+                               swap_multiplier: float = 10, initial_seed: int = 0,
+                               max_malloc: int = 4000000000, n_jobs: int = 1):
+    """
+    Compute XSwap priors for a given set of node pairs only. Occurrences of the
+    queried pairs and of every degree pair are counted in the backend, so
+    memory is proportional to the number of queries, nodes, and distinct degree
+    pairs. No node-pair matrix is created.
+
+    Parameters
+    ----------
+    edge_list : List[Tuple[int, int]]
+        Edge list representing the graph whose XSwap edge priors are to be
+        computed. Node values are their indices in the (bi)adjacency matrix.
+    query_pairs : List[Tuple[int, int]] or numpy.ndarray
+        Node pairs (source, target) whose priors are returned. An array should
+        have shape (n_queries, 2).
+    n_permutations, shape, allow_self_loops, allow_antiparallel,
+    swap_multiplier, initial_seed, max_malloc, n_jobs
+        See `compute_xswap_priors`
+
+    Returns
+    -------
+    query_df : pandas.DataFrame
+        One row per query, in the order given. Columns are the following:
+        [source_id, target_id, edge, source_degree, target_degree,
+         num_permuted_edges, pair_prior, xswap_prior]
+        where `num_permuted_edges` is the number of permutations in which the
+        pair was an edge, `pair_prior` is that number divided by
+        `n_permutations`, and `xswap_prior` is the degree-grouped prior as in
+        `compute_xswap_priors`.
+    """
+    import xswap._xswap_backend
+    edge_list, max_id = xswap.network_formats._backend_edges(edge_list)
+    query_pairs = numpy.ascontiguousarray(query_pairs, dtype=numpy.int32).reshape(-1, 2)
+
+    original_edges = xswap.network_formats.edges_to_matrix(
+        edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
+        dtype=bool, sparse=True).tocsr()
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
+
+    num_swaps = int(swap_multiplier * len(edge_list))
+    (source_values, target_values, source_nodes, target_nodes, counts,
+     query_counts) = xswap._xswap_backend._xswap_query_counts(
+        edge_list, max_id, allow_self_loops, allow_antiparallel, num_swaps,
+        initial_seed, n_permutations, max_malloc, source_degrees, target_degrees,
+        query_pairs, xswap.network_formats._num_threads(n_jobs))
+    degree_prior_df = _degree_pair_table(source_values, target_values, source_nodes,
+                                         target_nodes, counts, n_permutations)
+
+    query_df = pandas.DataFrame({
+        'source_id': query_pairs[:, 0],
+        'target_id': query_pairs[:, 1],
+        'edge': numpy.asarray(original_edges[query_pairs[:, 0], query_pairs[:, 1]]).flatten(),
+        'source_degree': source_degrees[query_pairs[:, 0]],
+        'target_degree': target_degrees[query_pairs[:, 1]],
+        'num_permuted_edges': numpy.frombuffer(query_counts, dtype=numpy.int64),
+    })
+    with numpy.errstate(divide='ignore', invalid='ignore'):
+        query_df['pair_prior'] = query_df['num_permuted_edges'] / n_permutations
+    query_df = query_df.merge(
+        degree_prior_df.filter(items=['source_degree', 'target_degree', 'xswap_prior']),
+        how='left', on=['source_degree', 'target_degree'])
+    return query_df
+
+
+class XSwapPriorAccumulator:
+    """
+    Degree-grouped XSwap prior that can be refined by adding permutations. The
+    accumulator stores, for every (source_degree, target_degree) pair, the
+    number of permuted edges and the sum of their squared per-permutation
+    numbers, along with the number of permutations run so far. Permutation `i`
+    always uses seed `initial_seed + i`, so adding permutations in several
+    batches gives the same counts as `compute_xswap_degree_priors` with the
+    total number of permutations. State can be saved and loaded to resume later.
+
+    Parameters
+    ----------
+    edge_list, shape, allow_self_loops, allow_antiparallel, swap_multiplier,
+    initial_seed, max_malloc
+        See `compute_xswap_priors`
+
+    Example
+    -------
+    >>> accumulator = XSwapPriorAccumulator(edges, shape=(100, 100))
+    >>> accumulator.add_permutations(100)
+    >>> accumulator.run_until(max_ci_width=0.01, batch_size=100)
+    >>> accumulator.save('priors.npz')
+    """
+    def __init__(self, edge_list: List[Tuple[int, int]], shape: Tuple[int, int],
+                 allow_self_loops: bool = False, allow_antiparallel: bool = False,
+                 swap_multiplier: float = 10, initial_seed: int = 0,
+                 max_malloc: int = 4000000000):
+        self.edge_list, self.max_id = xswap.network_formats._backend_edges(
+            xswap.network_formats._edge_array(edge_list))
+        self.shape = tuple(shape)
+        self.allow_self_loops = allow_self_loops
+        self.allow_antiparallel = allow_antiparallel
+        self.swap_multiplier = swap_multiplier
+        self.initial_seed = initial_seed
+        self.max_malloc = max_malloc
+
+        original_edges = xswap.network_formats.edges_to_matrix(
+            self.edge_list, add_reverse_edges=(not allow_antiparallel),
+            shape=self.shape, dtype=int, sparse=True)
+        self.source_degrees, self.target_degrees = _matrix_degrees(original_edges)
+
+        source_values, source_nodes = numpy.unique(self.source_degrees, return_counts=True)
+        target_values, target_nodes = numpy.unique(self.target_degrees, return_counts=True)
+        self.degree_pairs = pandas.DataFrame({
+            'source_degree': numpy.repeat(source_values, len(target_values)),
+            'target_degree': numpy.tile(target_values, len(source_values)),
+            'num_pairs': numpy.outer(source_nodes, target_nodes).flatten(),
+        })
+        self.n_permutations = 0
+        self.counts = numpy.zeros(len(self.degree_pairs), dtype=numpy.int64)
+        self.squared_counts = numpy.zeros(len(self.degree_pairs), dtype=numpy.int64)
+
+    def add_permutations(self, n_permutations: int, n_jobs: int = 1):
+        """
+        Run `n_permutations` more permutations, continuing from the next unused
+        seed, and add their counts
+        """
+        import xswap._xswap_backend
+        num_swaps = int(self.swap_multiplier * len(self.edge_list))
+        (source_values, target_values, source_nodes, target_nodes, counts,
+         squared_counts) = xswap._xswap_backend._xswap_degree_counts(
+            self.edge_list, self.max_id, self.allow_self_loops, self.allow_antiparallel,
+            num_swaps, self.initial_seed + self.n_permutations, n_permutations,
+            self.max_malloc, self.source_degrees, self.target_degrees,
+            xswap.network_formats._num_threads(n_jobs))
+        self.counts += numpy.frombuffer(counts, dtype=numpy.int64)
+        self.squared_counts += numpy.frombuffer(squared_counts, dtype=numpy.int64)
+        self.n_permutations += n_permutations
+
+    def standard_errors(self):
+        """
+        Standard error of the prior of every degree pair, from the variation of
+        per-permutation edge numbers. Requires at least two permutations;
+        otherwise, values are infinite.
+        """
+        n = self.n_permutations
+        if n < 2:
+            return numpy.full(len(self.counts), numpy.inf)
+        mean = self.counts / n
+        variance = (self.squared_counts - n * mean ** 2) / (n - 1)
+        variance = numpy.clip(variance, 0, None)
+        return numpy.sqrt(variance / n) / self.degree_pairs['num_pairs'].values
+
+    def max_ci_width(self, confidence: float = 0.95):
+        """
+        Largest width, over degree pairs, of the normal-approximation
+        confidence interval of the prior
+        """
+        z = scipy.stats.norm.ppf(0.5 + confidence / 2)
+        return 2 * z * self.standard_errors().max()
+
+    def run_until(self, max_ci_width: float, confidence: float = 0.95,
+                  batch_size: int = 100, max_permutations: int = None,
+                  n_jobs: int = 1):
+        """
+        Add permutations in batches of `batch_size` until the widest
+        `confidence` interval of any degree pair's prior is at most
+        `max_ci_width`, or until `max_permutations` permutations have been run.
+
+        Returns
+        -------
+        converged : bool
+            Whether the target width was reached
+        """
+        while self.n_permutations < 2 or self.max_ci_width(confidence) > max_ci_width:
+            n_batch = batch_size
+            if max_permutations is not None:
+                n_batch = min(n_batch, max_permutations - self.n_permutations)
+                if n_batch <= 0:
+                    return False
+            self.add_permutations(n_batch, n_jobs=n_jobs)
+        return True
+
+    def degree_priors(self):
+        """
+        Degree-pair prior table with the columns of
+        `compute_xswap_degree_priors` and a `standard_error` column
+        """
+        degree_prior_df = self.degree_pairs.assign(num_permuted_edges=self.counts)
+        with numpy.errstate(divide='ignore', invalid='ignore'):
+            degree_prior_df['xswap_prior'] = (
+                degree_prior_df['num_permuted_edges']
+                / (self.n_permutations * degree_prior_df['num_pairs'])
+            )
+        degree_prior_df['standard_error'] = self.standard_errors()
+        return degree_prior_df
+
+    def save(self, path):
+        """
+        Save the network, settings, and counts to a `.npz` file
+        """
+        numpy.savez_compressed(
+            path,
+            edges=self.edge_list,
+            shape=numpy.array(self.shape),
+            flags=numpy.array([self.allow_self_loops, self.allow_antiparallel]),
+            swap_multiplier=self.swap_multiplier,
+            initial_seed=self.initial_seed,
+            max_malloc=numpy.uint64(self.max_malloc),
+            n_permutations=self.n_permutations,
+            counts=self.counts,
+            squared_counts=self.squared_counts,
+        )
+
+    @classmethod
+    def load(cls, path):
+        """
+        Load an accumulator saved by `save`
+        """
+        with numpy.load(path) as data:
+            accumulator = cls(
+                data['edges'], tuple(data['shape'].tolist()),
+                allow_self_loops=bool(data['flags'][0]),
+                allow_antiparallel=bool(data['flags'][1]),
+                swap_multiplier=float(data['swap_multiplier']),
+                initial_seed=int(data['initial_seed']),
+                max_malloc=int(data['max_malloc']))
+            accumulator.n_permutations = int(data['n_permutations'])
+            accumulator.counts = data['counts'].copy()
+            accumulator.squared_counts = data['squared_counts'].copy()
+        return accumulator
 
 
 def approximate_xswap_prior(source_degree, target_degree, num_edges):
@@ -273,3 +751,200 @@ def approximate_xswap_prior(source_degree, target_degree, num_edges):
         (source_degree * target_degree) ** 2
         + (num_edges - source_degree - target_degree + 1) ** 2
     ) ** 0.5
+
+
+def approximate_xswap_degree_priors(edge_list: List[Tuple[int, int]],
+                                    shape: Tuple[int, int],
+                                    allow_antiparallel: bool = False):
+    """
+    Evaluate `approximate_xswap_prior` once for every (source_degree,
+    target_degree) pair of a network, in the backend. Node degrees are computed
+    as in `compute_xswap_priors`, and the number of edges is `len(edge_list)`.
+
+    Parameters
+    ----------
+    edge_list : List[Tuple[int, int]]
+        Edge list whose node values are their indices in the (bi)adjacency matrix
+    shape : Tuple[int, int]
+        The shape of the (bi)adjacency matrix
+    allow_antiparallel : bool
+        Whether the network is directed. If `False`, reverse edges are added
+        when computing degrees.
+
+    Returns
+    -------
+    degree_prior_df : pandas.DataFrame
+        One row per degree pair, sorted by degrees. Columns are the following:
+        [source_degree, target_degree, num_pairs, approximate_prior]
+    """
+    original_edges = xswap.network_formats.edges_to_matrix(
+        edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
+        dtype=int, sparse=True)
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
+    return _approximate_degree_pair_table(source_degrees, target_degrees, len(edge_list))
+
+
+def approximate_xswap_prior_matrix(edge_list: List[Tuple[int, int]],
+                                   shape: Tuple[int, int],
+                                   allow_antiparallel: bool = False,
+                                   dtype=numpy.float64):
+    """
+    Approximate XSwap prior for every node pair as a dense matrix. The
+    approximation is evaluated once per degree pair and scattered to node pairs
+    in the backend, without per-pair temporaries.
+
+    Parameters
+    ----------
+    edge_list, shape, allow_antiparallel
+        See `approximate_xswap_degree_priors`
+    dtype : numpy.float64 or numpy.float32
+        Dtype of the returned matrix. `numpy.float32` halves its memory.
+
+    Returns
+    -------
+    prior_matrix : numpy.ndarray
+        Matrix of shape `shape` where entry `[i, j]` is the approximate prior
+        of the node pair `(i, j)`
+    """
+    import xswap._xswap_backend
+    dtype = numpy.dtype(dtype)
+    if dtype not in (numpy.dtype(numpy.float32), numpy.dtype(numpy.float64)):
+        raise ValueError("dtype must be numpy.float32 or numpy.float64.")
+
+    original_edges = xswap.network_formats.edges_to_matrix(
+        edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
+        dtype=int, sparse=True)
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
+    del original_edges
+    source_values = numpy.unique(source_degrees)
+    target_values = numpy.unique(target_degrees)
+
+    prior_table = numpy.frombuffer(xswap._xswap_backend._approximate_degree_pairs(
+        source_values, target_values, float(len(edge_list))), dtype=numpy.float64)
+    prior_matrix = xswap._xswap_backend._scatter_degree_pairs(
+        prior_table, len(target_values),
+        numpy.searchsorted(source_values, source_degrees).astype(numpy.int32),
+        numpy.searchsorted(target_values, target_degrees).astype(numpy.int32),
+        0, shape[0], dtype == numpy.float32)
+    return numpy.frombuffer(prior_matrix, dtype=dtype).reshape(shape)
+
+
+def _approximate_degree_pair_table(source_degrees, target_degrees, num_edges):
+    """
+    Approximate prior of every pair of the distinct source and target degrees
+    """
+    import xswap._xswap_backend
+    source_values, source_nodes = numpy.unique(source_degrees, return_counts=True)
+    target_values, target_nodes = numpy.unique(target_degrees, return_counts=True)
+    source_values = source_values.astype(numpy.int32)
+    target_values = target_values.astype(numpy.int32)
+    prior_table = xswap._xswap_backend._approximate_degree_pairs(
+        source_values, target_values, float(num_edges))
+    return pandas.DataFrame({
+        'source_degree': numpy.repeat(source_values, len(target_values)),
+        'target_degree': numpy.tile(target_values, len(source_values)),
+        'num_pairs': numpy.outer(source_nodes, target_nodes).flatten(),
+        'approximate_prior': numpy.frombuffer(prior_table, dtype=numpy.float64),
+    })
+
+
+def compute_hybrid_xswap_priors(edge_list: List[Tuple[int, int]],
+                                shape: Tuple[int, int], n_permutations: int = 10,
+                                allow_self_loops: bool = False,
+                                allow_antiparallel: bool = False,
+                                swap_multiplier: float = 10, initial_seed: int = 0,
+                                max_malloc: int = 4000000000, n_jobs: int = 1,
+                                reference_priors=None):
+    """
+    Estimate degree-grouped XSwap priors from the analytic approximation,
+    corrected using a small number of permutations. Degree pairs are bucketed
+    by `floor(log2(source_degree * target_degree))`. In each bucket, the number
+    of edges observed across the permutations is compared to the number
+    expected under the approximation, and the approximate priors of the bucket
+    are scaled by their ratio (and capped at one). Buckets pool many degree
+    pairs, so few permutations give a stable correction of the approximation's
+    bias for high-degree pairs.
+
+    Parameters
+    ----------
+    edge_list, shape, n_permutations, allow_self_loops, allow_antiparallel,
+    swap_multiplier, initial_seed, max_malloc, n_jobs
+        See `compute_xswap_priors`. `n_permutations` is the number of
+        permutations used for the correction.
+    reference_priors : pandas.DataFrame or None
+        Optional degree-pair table from `compute_xswap_degree_priors` with many
+        more permutations. If given, accuracy metrics are computed against its
+        `xswap_prior` column, over the degree pairs it contains.
+
+    Returns
+    -------
+    degree_prior_df : pandas.DataFrame
+        One row per degree pair. Columns are the following:
+        [source_degree, target_degree, num_pairs, num_permuted_edges,
+         empirical_prior, approximate_prior, bucket, xswap_prior]
+        where `xswap_prior` is the corrected prior.
+    metrics : Dict[str, float] or None
+        Root-mean-square, mean absolute, and maximum absolute errors against
+        `reference_priors`, weighted by the number of node pairs, of the
+        `approximate`, `empirical`, and corrected `hybrid` priors. For example,
+        `hybrid_rmse`. `num_degree_pairs` is the number of degree pairs
+        compared. None without `reference_priors`.
+    """
+    original_edges = xswap.network_formats.edges_to_matrix(
+        edge_list, add_reverse_edges=(not allow_antiparallel), shape=shape,
+        dtype=int, sparse=True)
+    source_degrees, target_degrees = _matrix_degrees(original_edges)
+    del original_edges
+
+    degree_prior_df = _degree_pair_priors(
+        edge_list, source_degrees, target_degrees, n_permutations,
+        allow_self_loops=allow_self_loops, allow_antiparallel=allow_antiparallel,
+        swap_multiplier=swap_multiplier, initial_seed=initial_seed,
+        max_malloc=max_malloc, n_jobs=n_jobs)
+    degree_prior_df = degree_prior_df.rename(columns={'xswap_prior': 'empirical_prior'})
+    approximate_df = _approximate_degree_pair_table(
+        source_degrees, target_degrees, len(edge_list))
+    degree_prior_df['approximate_prior'] = approximate_df['approximate_prior'].values
+
+    degree_product = (degree_prior_df['source_degree'].values.astype(numpy.float64)
+                      * degree_prior_df['target_degree'].values)
+    with numpy.errstate(divide='ignore'):
+        degree_prior_df['bucket'] = numpy.where(
+            degree_product > 0, numpy.floor(numpy.log2(degree_product)), -1).astype(int)
+
+    # Observed and approximation-expected edges per bucket, across permutations
+    expected_edges = (n_permutations * degree_prior_df['num_pairs']
+                      * degree_prior_df['approximate_prior'])
+    bucket_totals = (
+        degree_prior_df
+        .assign(expected_edges=expected_edges)
+        .groupby('bucket')[['num_permuted_edges', 'expected_edges']]
+        .transform('sum')
+    )
+    with numpy.errstate(divide='ignore', invalid='ignore'):
+        correction = (bucket_totals['num_permuted_edges']
+                      / bucket_totals['expected_edges']).values
+    correction[~numpy.isfinite(correction)] = 1
+    degree_prior_df['xswap_prior'] = numpy.minimum(
+        degree_prior_df['approximate_prior'].values * correction, 1)
+
+    if reference_priors is None:
+        return degree_prior_df, None
+
+    # Only degree pairs in the reference are scored
+    compared = degree_prior_df.merge(
+        reference_priors[['source_degree', 'target_degree', 'xswap_prior']],
+        how='inner', on=['source_degree', 'target_degree'], suffixes=('', '_reference'))
+    if len(compared) == 0:
+        raise ValueError("reference_priors has none of the degree pairs of the network.")
+    reference = compared['xswap_prior_reference'].values
+    weights = compared['num_pairs'].values
+    metrics = {'num_degree_pairs': len(compared)}
+    for name, column in [('approximate', 'approximate_prior'),
+                         ('empirical', 'empirical_prior'),
+                         ('hybrid', 'xswap_prior')]:
+        error = numpy.abs(compared[column].values - reference)
+        metrics[name + '_rmse'] = float(numpy.sqrt(numpy.average(error ** 2, weights=weights)))
+        metrics[name + '_mae'] = float(numpy.average(error, weights=weights))
+        metrics[name + '_max_error'] = float(error.max())
+    return degree_prior_df, metrics
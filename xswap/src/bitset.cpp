@@ -1,9 +1,41 @@
+#include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 #include "xswap.h"
 
 int CHAR_BITS = 8*sizeof(char);
 
+static void print_warning(const char *message) {
+    std::cerr << "Warning: " << message << std::endl;
+}
+
+static WarningHandler warning_handler = print_warning;
+
+WarningHandler set_warning_handler(WarningHandler handler) {
+    WarningHandler previous = warning_handler;
+    warning_handler = handler != NULL ? handler : print_warning;
+    return previous;
+}
+
+// Capture of the current thread, if any
+static thread_local std::vector<std::string>* captured_warnings = NULL;
+
+void emit_warning(const char *message) {
+    if (captured_warnings != NULL)
+        captured_warnings->push_back(message);
+    else
+        warning_handler(message);
+}
+
+WarningCapture::WarningCapture(std::vector<std::string> *messages)
+        : previous(captured_warnings) {
+    captured_warnings = messages;
+}
+
+WarningCapture::~WarningCapture() {
+    captured_warnings = previous;
+}
+
 size_t cantor_pair(int* edge) {
     size_t source = edge[0];
     size_t target = edge[1];
@@ -52,10 +84,33 @@ void UncompressedBitSet::remove(int *edge) {
     set_bit_false(&bitset[edge_cantor / CHAR_BITS], edge_cantor % CHAR_BITS);
 }
 
+/* Return the set to the state it had when built from `original_edges`. Only
+ the bits of `current_edges` can be set, so clearing those and setting the
+ original ones is O(E) and avoids re-zeroing or reallocating the whole array. */
+void UncompressedBitSet::reset(Edges current_edges, Edges original_edges) {
+    for (int i = 0; i < current_edges.num_edges; i++) {
+        size_t edge_cantor = cantor_pair(current_edges.edge_array[i]);
+        if (edge_cantor > max_cantor)
+            throw std::out_of_range("Attempting to reset an out-of-bounds element.");
+        set_bit_false(&bitset[edge_cantor / CHAR_BITS], edge_cantor % CHAR_BITS);
+    }
+    for (int i = 0; i < original_edges.num_edges; i++) {
+        size_t edge_cantor = cantor_pair(original_edges.edge_array[i]);
+        if (edge_cantor > max_cantor)
+            throw std::out_of_range("Attempting to reset an out-of-bounds element.");
+        set_bit_true(&bitset[edge_cantor / CHAR_BITS], edge_cantor % CHAR_BITS);
+    }
+}
+
 void UncompressedBitSet::free_array() {
     free(bitset);
 }
 
+// Bytes allocated for the array by `create_bitset`
+size_t UncompressedBitSet::size_in_bytes() const {
+    return (max_cantor + CHAR_BITS - (max_cantor % CHAR_BITS)) / CHAR_BITS;
+}
+
 // num_elements corresponds to the minimum number of bits that are needed
 void UncompressedBitSet::create_bitset(size_t num_elements,
                                        unsigned long long int max_malloc) {
@@ -111,6 +166,22 @@ void RoaringBitSet::remove(int *edge) {
     }
 }
 
+void RoaringBitSet::reset(Edges current_edges, Edges original_edges) {
+    for (int i = 0; i < current_edges.num_edges; i++) {
+        int edge_cantor = cantor_pair(current_edges.edge_array[i]);
+        bitmap.remove(edge_cantor);
+    }
+    for (int i = 0; i < original_edges.num_edges; i++) {
+        int edge_cantor = cantor_pair(original_edges.edge_array[i]);
+        bitmap.add(edge_cantor);
+    }
+}
+
+// Approximate memory used by the bitmap, as its serialized size
+size_t RoaringBitSet::size_in_bytes() const {
+    return bitmap.getSizeInBytes();
+}
+
 BitSet::BitSet(Edges edges, unsigned long long int max_malloc) {
     int max_pair[2] = {edges.max_id, edges.max_id};
     size_t max_cantor = cantor_pair(max_pair);
@@ -125,10 +196,9 @@ BitSet::BitSet(Edges edges, unsigned long long int max_malloc) {
     }
 }
 
-PyObject *BitSet::runtime_warning_roaring(void) {
+void BitSet::runtime_warning_roaring(void) {
     // Roaring bitset is significantly slower, but used because of large network sizes
-    PyErr_WarnEx(PyExc_RuntimeWarning, "Using Roaring bitset because of the large number of edges.", 2);
-    return NULL;
+    emit_warning("Using Roaring bitset because of the large number of edges.");
 }
 
 bool BitSet::contains(int *edge) {
@@ -155,6 +225,22 @@ void BitSet::remove(int *edge) {
     }
 }
 
+void BitSet::reset(Edges current_edges, Edges original_edges) {
+    if (use_compressed) {
+        return compressed_set.reset(current_edges, original_edges);
+    } else {
+        return uncompressed_set.reset(current_edges, original_edges);
+    }
+}
+
+size_t BitSet::size_in_bytes() const {
+    if (use_compressed) {
+        return compressed_set.size_in_bytes();
+    } else {
+        return uncompressed_set.size_in_bytes();
+    }
+}
+
 void BitSet::free_array() {
     if (use_compressed) {
         return;
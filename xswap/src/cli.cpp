@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "xswap.h"
+
+/* Command-line tool for permuting edge files in batch with the XSwap engine,
+ equivalent to `xswap.write_permutations` without Python. */
+
+static const char USAGE[] =
+    "Usage: xswap [options] INPUT\n"
+    "\n"
+    "Permute the network in INPUT, a delimited text or binary edge file, and\n"
+    "write each permutation to disk. Permutation i uses seed SEED + i, as in\n"
+    "the Python package, so outputs do not depend on the number of threads.\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output PATH         output path, where \"{}\" is replaced by the\n"
+    "                            permutation index (default: permutation_{}.csv)\n"
+    "  -f, --format FORMAT       text, binary or ensemble (default: text)\n"
+    "  -n, --permutations N      number of permutations (default: 1)\n"
+    "  -s, --seed SEED           seed of the first permutation (default: 0)\n"
+    "  -m, --multiplier M        swap attempts per edge (default: 10)\n"
+    "  -t, --threads T           permutations run at once, 0 for one per CPU\n"
+    "                            (default: 1)\n"
+    "      --allow-self-loops    allow swaps that create self-loops\n"
+    "      --allow-antiparallel  allow swaps that create antiparallel edges\n"
+    "      --exclude PATH        edge file of edges that may not be created\n"
+    "      --max-malloc BYTES    largest uncompressed bitset per thread\n"
+    "                            (default: 4000000000)\n"
+    "      --node-delim C        text node delimiter (default: ,)\n"
+    "      --edge-delim C        text edge delimiter (default: \\n)\n"
+    "      --stats PATH          write JSON statistics to PATH, or - for stdout\n"
+    "  -h, --help                show this message\n";
+
+static const char VALUE_OPTIONS[] =
+    " -o --output -f --format -n --permutations -s --seed -m --multiplier -t --threads"
+    " --exclude --max-malloc --node-delim --edge-delim --stats ";
+
+struct Options {
+    std::string input_path;
+    std::string output_path = "permutation_{}.csv";
+    std::string output_format = "text";
+    std::string excluded_path;
+    std::string stats_path;
+    int num_permutations = 1;
+    int seed = 0;
+    double multiplier = 10;
+    int num_threads = 1;
+    bool allow_self_loop = false;
+    bool allow_antiparallel = false;
+    unsigned long long int max_malloc = 4000000000ULL;
+    char node_delim = ',';
+    char edge_delim = '\n';
+};
+
+static long long parse_integer(const std::string &name, const std::string &value) {
+    char* end;
+    errno = 0;
+    long long parsed = strtoll(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0')
+        throw std::invalid_argument(name + " must be an integer, not '" + value + "'.");
+    if (errno == ERANGE)
+        throw std::invalid_argument(name + " is out of range: " + value + ".");
+    return parsed;
+}
+
+static int parse_int(const std::string &name, const std::string &value, int min_value) {
+    long long parsed = parse_integer(name, value);
+    if (parsed < min_value || parsed > INT_MAX)
+        throw std::invalid_argument(name + " is out of range: " + value + ".");
+    return (int)parsed;
+}
+
+static unsigned long long int parse_bytes(const std::string &name, const std::string &value) {
+    long long parsed = parse_integer(name, value);
+    if (parsed < 0)
+        throw std::invalid_argument(name + " is out of range: " + value + ".");
+    return (unsigned long long int)parsed;
+}
+
+// A single character, or one of the escapes \t and \n
+static char parse_delimiter(const std::string &name, const std::string &value) {
+    if (value == "\\t")
+        return '\t';
+    if (value == "\\n")
+        return '\n';
+    if (value.size() != 1 || (unsigned char)value[0] > 127)
+        throw std::invalid_argument(name + " must be a single ASCII character.");
+    return value[0];
+}
+
+static Options parse_options(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << USAGE;
+            exit(0);
+        }
+        if (arg == "--allow-self-loops") {
+            options.allow_self_loop = true;
+            continue;
+        }
+        if (arg == "--allow-antiparallel") {
+            options.allow_antiparallel = true;
+            continue;
+        }
+        if (arg.empty() || arg[0] != '-') {
+            if (!options.input_path.empty())
+                throw std::invalid_argument("Only one input file may be given.");
+            options.input_path = arg;
+            continue;
+        }
+
+        // Options with a value, as "--name value" or "--name=value"
+        std::string name = arg, value;
+        size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") == 0 && equals != std::string::npos)
+            name = arg.substr(0, equals);
+        if (strstr(VALUE_OPTIONS, (" " + name + " ").c_str()) == NULL)
+            throw std::invalid_argument("Unknown option " + name + ".");
+        if (name != arg)
+            value = arg.substr(equals + 1);
+        else if (i + 1 < argc)
+            value = argv[++i];
+        else
+            throw std::invalid_argument("Missing value for " + arg + ".");
+
+        if (name == "-o" || name == "--output")
+            options.output_path = value;
+        else if (name == "-f" || name == "--format")
+            options.output_format = value;
+        else if (name == "-n" || name == "--permutations")
+            options.num_permutations = parse_int(name, value, 0);
+        else if (name == "-s" || name == "--seed")
+            options.seed = parse_int(name, value, INT_MIN);
+        else if (name == "-m" || name == "--multiplier") {
+            char* end;
+            options.multiplier = strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || options.multiplier < 0)
+                throw std::invalid_argument(name + " must be a non-negative number.");
+        }
+        else if (name == "-t" || name == "--threads")
+            options.num_threads = parse_int(name, value, 0);
+        else if (name == "--exclude")
+            options.excluded_path = value;
+        else if (name == "--max-malloc")
+            options.max_malloc = parse_bytes(name, value);
+        else if (name == "--node-delim")
+            options.node_delim = parse_delimiter(name, value);
+        else if (name == "--edge-delim")
+            options.edge_delim = parse_delimiter(name, value);
+        else if (name == "--stats")
+            options.stats_path = value;
+    }
+
+    if (options.input_path.empty())
+        throw std::invalid_argument("No input file given.");
+    if (options.output_format != "text" && options.output_format != "binary"
+            && options.output_format != "ensemble")
+        throw std::invalid_argument("Output format must be 'text', 'binary' or 'ensemble'.");
+    if (options.output_format != "ensemble" && options.num_permutations > 1
+            && options.output_path.find("{}") == std::string::npos)
+        throw std::invalid_argument(
+            "Output path must contain \"{}\" to write several permutations.");
+    if (options.num_threads == 0)
+        options.num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    return options;
+}
+
+// Edges in an edge file, text or binary, as allocated `Edges`
+static Edges read_edges(const std::string &path, const Options &options,
+                        bool check_duplicates) {
+    std::vector<int> packed_edges;
+    int max_id;
+    size_t num_edges = load_edge_file(path.c_str(), options.node_delim, options.edge_delim,
+                                      options.num_threads, packed_edges, &max_id);
+    if (num_edges > INT_MAX)
+        throw std::invalid_argument(path + " has too many edges.");
+    if (check_duplicates && has_duplicate_edges(packed_edges.data(), num_edges))
+        throw std::invalid_argument(path + " contains duplicate edges. "
+                                    "XSwap does not support multigraphs.");
+    Edges edges = allocate_edges((int)num_edges);
+    if (num_edges > 0)
+        memcpy(edges.edge_array[0], packed_edges.data(), sizeof(int) * 2 * num_edges);
+    edges.max_id = max_id;
+    return edges;
+}
+
+static std::string json_string(const std::string &value) {
+    std::string escaped = "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if (c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped + "\"";
+}
+
+static void write_stats(std::ostream &output, const Options &options, Edges edges,
+                        int num_swaps, double seconds,
+                        const std::vector<statsCounter> &stats) {
+    output << "{\n"
+           << "  \"input\": " << json_string(options.input_path) << ",\n"
+           << "  \"output\": " << json_string(options.output_path) << ",\n"
+           << "  \"format\": " << json_string(options.output_format) << ",\n"
+           << "  \"num_edges\": " << edges.num_edges << ",\n"
+           << "  \"max_id\": " << edges.max_id << ",\n"
+           << "  \"num_permutations\": " << options.num_permutations << ",\n"
+           << "  \"seed\": " << options.seed << ",\n"
+           << "  \"multiplier\": " << options.multiplier << ",\n"
+           << "  \"num_swaps\": " << num_swaps << ",\n"
+           << "  \"allow_self_loops\": " << (options.allow_self_loop ? "true" : "false") << ",\n"
+           << "  \"allow_antiparallel\": " << (options.allow_antiparallel ? "true" : "false")
+           << ",\n"
+           << "  \"threads\": " << options.num_threads << ",\n"
+           << "  \"seconds\": " << seconds << ",\n"
+           << "  \"permutations\": [";
+    for (size_t i = 0; i < stats.size(); i++) {
+        output << (i > 0 ? "," : "") << "\n    {\"seed\": " << options.seed + (long long)i
+               << ", \"swap_attempts\": " << stats[i].num_swaps
+               << ", \"same_edge\": " << stats[i].same_edge
+               << ", \"self_loop\": " << stats[i].self_loop
+               << ", \"duplicate\": " << stats[i].duplicate
+               << ", \"undir_duplicate\": " << stats[i].undir_duplicate
+               << ", \"excluded\": " << stats[i].excluded << "}";
+    }
+    output << (stats.empty() ? "]\n" : "\n  ]\n") << "}\n";
+}
+
+static int run(const Options &options) {
+    Edges edges = read_edges(options.input_path, options, true);
+    Conditions cond;
+    cond.seed = options.seed;
+    cond.allow_self_loop = options.allow_self_loop;
+    cond.allow_antiparallel = options.allow_antiparallel;
+    cond.excluded_edges = options.excluded_path.empty()
+                          ? allocate_edges(0) : read_edges(options.excluded_path, options, false);
+
+    int num_swaps = (int)(options.multiplier * edges.num_edges);
+    std::vector<statsCounter> stats;
+    std::chrono::duration<double> elapsed;
+    try {
+        const int* packed_edges = edges.num_edges > 0 ? edges.edge_array[0] : NULL;
+        const char* path = options.output_path.c_str();
+        std::unique_ptr<PermutationSink> sink;
+        if (options.output_format == "text")
+            sink.reset(new TextPermutationSink(path, options.node_delim, options.edge_delim));
+        else if (options.output_format == "binary")
+            sink.reset(new BinaryPermutationSink(path, packed_edges, edges.num_edges, 0));
+        else
+            sink.reset(new EnsemblePermutationSink(path, packed_edges, edges.num_edges));
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        write_permutations(edges, num_swaps, options.num_permutations, cond,
+                           options.max_malloc, *sink, true, stats, options.num_threads);
+        elapsed = std::chrono::steady_clock::now() - start;
+    } catch (...) {
+        free_edges(edges);
+        free_edges(cond.excluded_edges);
+        throw;
+    }
+
+    if (options.stats_path == "-") {
+        write_stats(std::cout, options, edges, num_swaps, elapsed.count(), stats);
+    } else if (!options.stats_path.empty()) {
+        std::ofstream stats_file(options.stats_path.c_str());
+        write_stats(stats_file, options, edges, num_swaps, elapsed.count(), stats);
+        if (!stats_file)
+            throw std::runtime_error("Could not write " + options.stats_path);
+    }
+    free_edges(edges);
+    free_edges(cond.excluded_edges);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << "xswap: " << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+    try {
+        return run(options);
+    } catch (const std::exception &e) {
+        std::cerr << "xswap: " << e.what() << "\n";
+        return 1;
+    }
+}
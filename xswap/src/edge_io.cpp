@@ -0,0 +1,828 @@
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "xswap.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* View of a whole file. The file is memory-mapped where available and read
+ into memory otherwise. A writable view is private, so changes are never
+ written back to the file. */
+class MappedFile
+{
+    public:
+        MappedFile(const char *path, bool writable = false);
+        ~MappedFile();
+        char* data() const { return bytes; }
+        size_t size() const { return num_bytes; }
+
+    private:
+        char* bytes;
+        size_t num_bytes;
+        bool mapped;
+        std::vector<char> buffer;
+};
+
+MappedFile::MappedFile(const char *path, bool writable)
+        : bytes(NULL), num_bytes(0), mapped(false) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Could not open ") + path);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("Could not read ") + path);
+    }
+    num_bytes = (size_t)file_stat.st_size;
+    if (num_bytes > 0) {
+        int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* address = mmap(NULL, num_bytes, protection, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, num_bytes, MADV_SEQUENTIAL);
+            bytes = (char*)address;
+            mapped = true;
+        }
+    }
+    close(fd);
+    if (mapped || num_bytes == 0)
+        return;
+#endif
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(std::string("Could not open ") + path);
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bytes = buffer.data();
+    num_bytes = buffer.size();
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped)
+        munmap(bytes, num_bytes);
+#endif
+}
+
+/* FNV-1a over 32-bit words, which checks the packed edges of a binary edge
+ file four times faster than hashing bytes. */
+static unsigned long long edge_checksum(const int *edges, size_t num_edges) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < 2 * num_edges; i++) {
+        hash = (hash ^ (unsigned int)edges[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Return whether `data` starts with a binary edge file header, checking that
+ the header is consistent with the file size. */
+static bool is_binary_edge_file(const char *data, size_t size) {
+    if (size < sizeof(EdgeFileHeader) || memcmp(data, EDGE_FILE_MAGIC, 8) != 0)
+        return false;
+    EdgeFileHeader header;
+    memcpy(&header, data, sizeof(EdgeFileHeader));
+    if (header.version != EDGE_FILE_VERSION)
+        throw std::invalid_argument("Unsupported binary edge file version "
+                                    + std::to_string(header.version) + ".");
+    if (size != sizeof(EdgeFileHeader) + 2 * sizeof(int) * header.num_edges)
+        throw std::invalid_argument("Binary edge file is truncated.");
+    return true;
+}
+
+/* Header for packed edges, with node ranges computed from the edges */
+EdgeFileHeader make_edge_file_header(const int *edges, size_t num_edges,
+                                     unsigned int flags) {
+    EdgeFileHeader header;
+    memset(&header, 0, sizeof(EdgeFileHeader));
+    memcpy(header.magic, EDGE_FILE_MAGIC, 8);
+    header.version = EDGE_FILE_VERSION;
+    header.flags = flags;
+    header.num_edges = num_edges;
+    header.max_source_id = -1;
+    header.max_target_id = -1;
+    for (size_t i = 0; i < num_edges; i++) {
+        if (edges[2 * i] < 0 || edges[2 * i + 1] < 0)
+            throw std::invalid_argument("Node ids must be non-negative.");
+        header.max_source_id = std::max(header.max_source_id, edges[2 * i]);
+        header.max_target_id = std::max(header.max_target_id, edges[2 * i + 1]);
+    }
+    header.checksum = edge_checksum(edges, num_edges);
+    return header;
+}
+
+/* Write packed edges as a binary edge file: an `EdgeFileHeader` followed by
+ `num_edges` native-endian int32 `(source, target)` pairs. */
+void write_edge_file(const char *path, const EdgeFileHeader &header, const int *edges) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error(std::string("Could not open ") + path);
+    file.write((const char*)&header, sizeof(EdgeFileHeader));
+    file.write((const char*)edges, 2 * sizeof(int) * header.num_edges);
+    if (!file)
+        throw std::runtime_error(std::string("Could not write ") + path);
+}
+
+/* Permute the edges of a binary edge file without parsing or copying them.
+ The file is mapped privately and swapped in place; the mapping is then
+ written to `output_path` if given, and copied to `permuted_edges` otherwise.
+ The input file is never modified. */
+void permute_edge_file(const char *input_path, const char *output_path,
+                       int num_swaps, Conditions cond, statsCounter *stats,
+                       unsigned long long int max_malloc,
+                       std::vector<int> *permuted_edges) {
+    MappedFile file(input_path, true);
+    if (!is_binary_edge_file(file.data(), file.size()))
+        throw std::invalid_argument(std::string(input_path) + " is not a binary edge file.");
+    EdgeFileHeader header;
+    memcpy(&header, file.data(), sizeof(EdgeFileHeader));
+    if (header.num_edges > INT_MAX)
+        throw std::length_error("Edge file has more edges than are supported.");
+
+    // Corrupted edges or node ranges would be permuted and written back with
+    // a valid checksum, or index outside the bitset
+    int* packed_edges = (int*)(file.data() + sizeof(EdgeFileHeader));
+    if (edge_checksum(packed_edges, header.num_edges) != header.checksum)
+        throw std::invalid_argument(std::string("Checksum mismatch in ") + input_path);
+    for (size_t i = 0; i < header.num_edges; i++) {
+        if (packed_edges[2 * i] < 0 || packed_edges[2 * i] > header.max_source_id
+                || packed_edges[2 * i + 1] < 0
+                || packed_edges[2 * i + 1] > header.max_target_id)
+            throw std::invalid_argument(std::string("Node id out of range in ") + input_path);
+    }
+
+    Edges edges;
+    edges.num_edges = (int)header.num_edges;
+    edges.max_id = std::max(header.max_source_id, header.max_target_id);
+    std::vector<int*> edge_pointers(edges.num_edges);
+    for (int i = 0; i < edges.num_edges; i++) {
+        edge_pointers[i] = packed_edges + 2 * (size_t)i;
+    }
+    edges.edge_array = edge_pointers.data();
+
+    swap_edges(edges, num_swaps, cond, stats, max_malloc);
+
+    // Swaps preserve the degree sequence, so only the checksum changes
+    header.checksum = edge_checksum(packed_edges, header.num_edges);
+    if (output_path != NULL)
+        write_edge_file(output_path, header, packed_edges);
+    else
+        permuted_edges->assign(packed_edges, packed_edges + 2 * header.num_edges);
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* Parse a non-negative node id, allowing surrounding whitespace and a leading
+ `+` like Python's `int`. Returns false if the field is not such an integer. */
+static bool parse_node_id(const char *begin, const char *end, int *node_id) {
+    while (begin < end && is_space(*begin))
+        begin++;
+    while (end > begin && is_space(end[-1]))
+        end--;
+    if (begin < end && *begin == '+')
+        begin++;
+    if (begin == end)
+        return false;
+    long long value = 0;
+    for (; begin < end; begin++) {
+        if (*begin < '0' || *begin > '9')
+            return false;
+        value = 10 * value + (*begin - '0');
+        if (value > INT_MAX)
+            return false;
+    }
+    *node_id = (int)value;
+    return true;
+}
+
+/* Parse the records in `[begin, end)`, writing `(source, target)` pairs to
+ `output` and their number to `num_parsed`. Records with fewer than two
+ fields, such as blank lines, are skipped and fields after the second are
+ ignored. Returns a pointer to the first invalid record, or NULL if all
+ records were valid. */
+static const char* parse_edge_chunk(const char *begin, const char *end,
+                                    char node_delim, char edge_delim,
+                                    int *output, size_t *num_parsed) {
+    int* next = output;
+    const char* error = NULL;
+    while (begin < end) {
+        const char* record_end = (const char*)memchr(begin, edge_delim, end - begin);
+        if (record_end == NULL)
+            record_end = end;
+        const char* first_delim = (const char*)memchr(begin, node_delim, record_end - begin);
+        if (first_delim != NULL) {
+            const char* second_delim = (const char*)memchr(
+                first_delim + 1, node_delim, record_end - first_delim - 1);
+            if (second_delim == NULL)
+                second_delim = record_end;
+            if (!parse_node_id(begin, first_delim, next) ||
+                    !parse_node_id(first_delim + 1, second_delim, next + 1)) {
+                error = begin;
+                break;
+            }
+            next += 2;
+        }
+        begin = record_end + 1;
+    }
+    *num_parsed = (next - output) / 2;
+    return error;
+}
+
+/* Load an integer edge list from a delimited text file into `edges`, packed as
+ `(source, target)` pairs, and return the number of edges. Binary edge files,
+ recognized by their header, are loaded directly. The file is
+ memory-mapped and split into `num_threads` chunks at record boundaries. Each
+ chunk counts its records, then parses them directly into its slice of
+ `edges`; slices are compacted afterwards if any records were skipped.
+ `max_id` receives the largest node id. */
+size_t load_edge_file(const char *path, char node_delim, char edge_delim,
+                      int num_threads, std::vector<int> &edges, int *max_id) {
+    MappedFile file(path);
+    const char* data = file.data();
+    size_t size = file.size();
+
+    // Binary edge files are copied without parsing after checking the checksum
+    if (is_binary_edge_file(data, size)) {
+        EdgeFileHeader header;
+        memcpy(&header, data, sizeof(EdgeFileHeader));
+        const int* packed_edges = (const int*)(data + sizeof(EdgeFileHeader));
+        if (edge_checksum(packed_edges, header.num_edges) != header.checksum)
+            throw std::invalid_argument(std::string("Checksum mismatch in ") + path);
+        edges.assign(packed_edges, packed_edges + 2 * header.num_edges);
+        *max_id = std::max(0, std::max(header.max_source_id, header.max_target_id));
+        return header.num_edges;
+    }
+
+    // Chunk boundaries fall just after an edge delimiter
+    int num_chunks = (int)std::max((size_t)1, std::min((size_t)std::max(num_threads, 1),
+                                                       size / 4096 + 1));
+    std::vector<size_t> bounds(num_chunks + 1, size);
+    bounds[0] = 0;
+    for (int c = 1; c < num_chunks; c++) {
+        size_t position = std::max(bounds[c - 1], size / num_chunks * c);
+        const char* next = (const char*)memchr(data + position, edge_delim, size - position);
+        bounds[c] = next == NULL ? size : next - data + 1;
+    }
+    auto run_chunks = [num_chunks](const std::function<void(int)> &task) {
+        std::vector<std::thread> workers;
+        for (int c = 1; c < num_chunks; c++) {
+            workers.push_back(std::thread(task, c));
+        }
+        task(0);
+        for (size_t w = 0; w < workers.size(); w++) {
+            workers[w].join();
+        }
+    };
+
+    // Count records, including a final record without a trailing delimiter
+    std::vector<size_t> offsets(num_chunks + 1, 0);
+    run_chunks([&](int c) {
+        const char* begin = data + bounds[c];
+        const char* end = data + bounds[c + 1];
+        offsets[c + 1] = std::count(begin, end, edge_delim);
+        if (end > begin && end[-1] != edge_delim)
+            offsets[c + 1] += 1;
+    });
+    for (int c = 0; c < num_chunks; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+
+    edges.resize(2 * offsets[num_chunks]);
+    std::vector<size_t> num_parsed(num_chunks, 0);
+    std::vector<const char*> errors(num_chunks, (const char*)NULL);
+    run_chunks([&](int c) {
+        errors[c] = parse_edge_chunk(data + bounds[c], data + bounds[c + 1], node_delim,
+                                     edge_delim, edges.data() + 2 * offsets[c], &num_parsed[c]);
+    });
+
+    for (int c = 0; c < num_chunks; c++) {
+        if (errors[c] == NULL)
+            continue;
+        const char* record_end = (const char*)memchr(errors[c], edge_delim,
+                                                     data + size - errors[c]);
+        if (record_end == NULL)
+            record_end = data + size;
+        long long line = 1 + std::count(data, errors[c], edge_delim);
+        throw std::invalid_argument("Invalid edge on line " + std::to_string(line) + ": '"
+            + std::string(errors[c], std::min(record_end - errors[c], (ptrdiff_t)80)) + "'");
+    }
+
+    size_t num_edges = 0;
+    for (int c = 0; c < num_chunks; c++) {
+        if (num_edges != offsets[c])
+            memmove(edges.data() + 2 * num_edges, edges.data() + 2 * offsets[c],
+                    2 * sizeof(int) * num_parsed[c]);
+        num_edges += num_parsed[c];
+    }
+    edges.resize(2 * num_edges);
+    *max_id = edges.empty() ? 0 : *std::max_element(edges.begin(), edges.end());
+    return num_edges;
+}
+
+/* Append `value` to `output` as a little-endian base-128 varint */
+static void write_varint(unsigned long long value, std::vector<unsigned char> &output) {
+    while (value >= 0x80) {
+        output.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back((unsigned char)value);
+}
+
+static bool read_varint(const unsigned char *&position, const unsigned char *end,
+                        unsigned long long *value) {
+    *value = 0;
+    for (int shift = 0; position < end && shift < 64; shift += 7) {
+        unsigned char byte = *position++;
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/* Encode the targets of a permutation as differences from the original
+ targets. Each nonzero difference `d` is the varint of `zigzag(d) << 1`, and a
+ run of `n` unchanged targets is the varint of `(n << 1) | 1`. Sources must be
+ unchanged, as they are by XSwap. */
+void encode_permutation(const int *original_edges, const int *permuted_edges,
+                        size_t num_edges, std::vector<unsigned char> &output) {
+    output.clear();
+    unsigned long long zero_run = 0;
+    for (size_t i = 0; i < num_edges; i++) {
+        if (permuted_edges[2 * i] != original_edges[2 * i])
+            throw std::invalid_argument("Permutation has different sources than the original edges.");
+        long long delta = (long long)permuted_edges[2 * i + 1] - original_edges[2 * i + 1];
+        if (delta == 0) {
+            zero_run++;
+            continue;
+        }
+        if (zero_run > 0) {
+            write_varint((zero_run << 1) | 1, output);
+            zero_run = 0;
+        }
+        unsigned long long zigzag = ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63);
+        write_varint(zigzag << 1, output);
+    }
+    if (zero_run > 0)
+        write_varint((zero_run << 1) | 1, output);
+}
+
+/* Inverse of `encode_permutation`, writing packed edges to `permuted_edges` */
+void decode_permutation(const int *original_edges, const unsigned char *data,
+                        size_t num_bytes, size_t num_edges, int *permuted_edges) {
+    const unsigned char* position = data;
+    const unsigned char* end = data + num_bytes;
+    size_t i = 0;
+    while (position < end) {
+        unsigned long long token;
+        if (!read_varint(position, end, &token))
+            throw std::invalid_argument("Corrupt permutation in ensemble file.");
+        if (token & 1) {
+            unsigned long long run = token >> 1;
+            if (run > num_edges - i)
+                throw std::invalid_argument("Corrupt permutation in ensemble file.");
+            memcpy(permuted_edges + 2 * i, original_edges + 2 * i, 2 * sizeof(int) * run);
+            i += run;
+        } else {
+            if (i >= num_edges)
+                throw std::invalid_argument("Corrupt permutation in ensemble file.");
+            unsigned long long zigzag = token >> 1;
+            long long delta = (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+            permuted_edges[2 * i] = original_edges[2 * i];
+            permuted_edges[2 * i + 1] = (int)(original_edges[2 * i + 1] + delta);
+            i++;
+        }
+    }
+    if (i != num_edges)
+        throw std::invalid_argument("Corrupt permutation in ensemble file.");
+}
+
+/* Create an ensemble file holding `edges`, or open an existing one to append
+ permutations of the edges it holds. */
+EnsembleWriter::EnsembleWriter(const char *path, const int *edges, size_t num_edges) {
+    if (edges != NULL) {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error(std::string("Could not open ") + path);
+        EdgeFileHeader edge_header = make_edge_file_header(edges, num_edges, 0);
+        memset(&header, 0, sizeof(EnsembleHeader));
+        memcpy(header.magic, ENSEMBLE_MAGIC, 8);
+        header.version = ENSEMBLE_VERSION;
+        header.num_edges = num_edges;
+        header.max_source_id = edge_header.max_source_id;
+        header.max_target_id = edge_header.max_target_id;
+        original_edges.assign(edges, edges + 2 * num_edges);
+        file.write((const char*)&header, sizeof(EnsembleHeader));
+        file.write((const char*)edges, 2 * sizeof(int) * num_edges);
+        next_block = sizeof(EnsembleHeader) + 2 * sizeof(int) * num_edges;
+    } else {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file)
+            throw std::runtime_error(std::string("Could not open ") + path);
+        file.read((char*)&header, sizeof(EnsembleHeader));
+        if (!file || memcmp(header.magic, ENSEMBLE_MAGIC, 8) != 0)
+            throw std::invalid_argument(std::string(path) + " is not an ensemble file.");
+        if (header.version != ENSEMBLE_VERSION)
+            throw std::invalid_argument("Unsupported ensemble file version "
+                                        + std::to_string(header.version) + ".");
+        original_edges.resize(2 * header.num_edges);
+        file.read((char*)original_edges.data(), 2 * sizeof(int) * header.num_edges);
+        if (!file)
+            throw std::invalid_argument("Ensemble file is truncated.");
+
+        // Append after the last counted block, overwriting anything left by
+        // an interrupted append
+        next_block = file.tellg();
+        for (unsigned long long p = 0; p < header.num_permutations; p++) {
+            unsigned long long block[2];
+            file.read((char*)block, sizeof(block));
+            if (!file)
+                throw std::invalid_argument("Ensemble file is truncated.");
+            next_block += sizeof(block) + block[0];
+            file.seekg(next_block);
+        }
+        file.seekp(next_block);
+    }
+    if (!file)
+        throw std::runtime_error(std::string("Could not write ") + path);
+}
+
+/* Append a permutation as a block: its encoded size, the checksum of its
+ edges, then the encoded targets. The permutation count in the header is
+ updated after the block is written, so an interrupted write leaves the
+ earlier permutations readable. */
+void EnsembleWriter::add_permutation(const int *permuted_edges) {
+    encode_permutation(original_edges.data(), permuted_edges, header.num_edges, encoded);
+    unsigned long long block[2] = {
+        (unsigned long long)encoded.size(), edge_checksum(permuted_edges, header.num_edges)};
+    file.seekp(next_block);
+    file.write((const char*)block, sizeof(block));
+    file.write((const char*)encoded.data(), encoded.size());
+    next_block += sizeof(block) + encoded.size();
+    header.num_permutations++;
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(EnsembleHeader));
+    if (!file)
+        throw std::runtime_error("Could not write permutation to ensemble file.");
+}
+
+/* Map an ensemble file and walk its blocks once to index the permutations */
+EnsembleReader::EnsembleReader(const char *path) : file(new MappedFile(path)) {
+    const char* data = file->data();
+    size_t size = file->size();
+    if (size < sizeof(EnsembleHeader) || memcmp(data, ENSEMBLE_MAGIC, 8) != 0)
+        throw std::invalid_argument(std::string(path) + " is not an ensemble file.");
+    memcpy(&header, data, sizeof(EnsembleHeader));
+    if (header.version != ENSEMBLE_VERSION)
+        throw std::invalid_argument("Unsupported ensemble file version "
+                                    + std::to_string(header.version) + ".");
+    size_t position = sizeof(EnsembleHeader) + 2 * sizeof(int) * header.num_edges;
+    for (unsigned long long p = 0; p < header.num_permutations; p++) {
+        unsigned long long block[2];
+        if (position + sizeof(block) > size)
+            throw std::invalid_argument("Ensemble file is truncated.");
+        memcpy(block, data + position, sizeof(block));
+        if (block[0] > size - position - sizeof(block))
+            throw std::invalid_argument("Ensemble file is truncated.");
+        block_offsets.push_back(position);
+        position += sizeof(block) + block[0];
+    }
+    if (position > size)
+        throw std::invalid_argument("Ensemble file is truncated.");
+}
+
+EnsembleReader::~EnsembleReader() {}
+
+const int* EnsembleReader::original_edges() const {
+    return (const int*)(file->data() + sizeof(EnsembleHeader));
+}
+
+/* Decode permutation `index` into `permuted_edges`, verifying its checksum */
+void EnsembleReader::permutation(size_t index, int *permuted_edges) const {
+    if (index >= block_offsets.size())
+        throw std::out_of_range("Permutation index is out of range.");
+    const char* block_data = file->data() + block_offsets[index];
+    unsigned long long block[2];
+    memcpy(block, block_data, sizeof(block));
+    decode_permutation(original_edges(), (const unsigned char*)block_data + sizeof(block),
+                       block[0], header.num_edges, permuted_edges);
+    if (edge_checksum(permuted_edges, header.num_edges) != block[1])
+        throw std::invalid_argument("Checksum mismatch in ensemble permutation "
+                                    + std::to_string(index) + ".");
+}
+
+/* Append `value` to `output` in decimal */
+static char* write_decimal(int value, char *output) {
+    char digits[12];
+    int num_digits = 0;
+    unsigned int remaining = value < 0 ? 0U - (unsigned int)value : (unsigned int)value;
+    do {
+        digits[num_digits++] = (char)('0' + remaining % 10);
+        remaining /= 10;
+    } while (remaining > 0);
+    if (value < 0)
+        *output++ = '-';
+    while (num_digits > 0)
+        *output++ = digits[--num_digits];
+    return output;
+}
+
+// Path for permutation `index`, replacing the first "{}" in `pattern`
+static std::string permutation_path(const std::string &pattern, int index) {
+    size_t position = pattern.find("{}");
+    if (position == std::string::npos)
+        return pattern;
+    return pattern.substr(0, position) + std::to_string(index) + pattern.substr(position + 2);
+}
+
+TextPermutationSink::TextPermutationSink(const char *path_pattern, char node_delim,
+                                         char edge_delim)
+        : path_pattern(path_pattern), node_delim(node_delim), edge_delim(edge_delim) {}
+
+/* Format edges as text in 1 MB chunks, without stdio formatting */
+void TextPermutationSink::write(int index, const int *edges, size_t num_edges) {
+    std::string path = permutation_path(path_pattern, index);
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Could not open " + path);
+    std::vector<char> buffer(1 << 20);
+    char* position = buffer.data();
+    for (size_t i = 0; i < num_edges; i++) {
+        // An edge takes at most 2 * 11 + 2 characters
+        if (position + 24 > buffer.data() + buffer.size()) {
+            file.write(buffer.data(), position - buffer.data());
+            position = buffer.data();
+        }
+        position = write_decimal(edges[2 * i], position);
+        *position++ = node_delim;
+        position = write_decimal(edges[2 * i + 1], position);
+        *position++ = edge_delim;
+    }
+    file.write(buffer.data(), position - buffer.data());
+    if (!file)
+        throw std::runtime_error("Could not write " + path);
+}
+
+BinaryPermutationSink::BinaryPermutationSink(const char *path_pattern, const int *edges,
+                                             size_t num_edges, unsigned int flags)
+        : path_pattern(path_pattern),
+          header(make_edge_file_header(edges, num_edges, flags)) {}
+
+// Node ranges are those of the original edges, which permutations preserve
+void BinaryPermutationSink::write(int index, const int *edges, size_t num_edges) {
+    EdgeFileHeader permutation_header = header;
+    permutation_header.checksum = edge_checksum(edges, num_edges);
+    write_edge_file(permutation_path(path_pattern, index).c_str(), permutation_header, edges);
+}
+
+EnsemblePermutationSink::EnsemblePermutationSink(const char *path, const int *edges,
+                                                 size_t num_edges)
+        : writer(path, edges, num_edges) {}
+
+void EnsemblePermutationSink::write(int, const int *edges, size_t) {
+    writer.add_permutation(edges);
+}
+
+/* Run permutations `first, first + step, ...` below `num_permutations` on
+ one of the threads of `write_permutations`, swapping `permuted_edges` in
+ `edges_set` and writing each result to `sink` directly. Ordered sinks are
+ written once every earlier permutation has been, tracked by `next_index`.
+ `failed` stops all workers once one of them has thrown. */
+static void write_permutation_stride(Edges edges, Edges permuted_edges, BitSet &edges_set,
+                                     int first, int step, int num_swaps,
+                                     int num_permutations, Conditions cond,
+                                     PermutationSink &sink, std::vector<statsCounter> &stats,
+                                     int &next_index, bool &failed, std::mutex &mutex,
+                                     std::condition_variable &condition) {
+    const int* packed_edges = edges.num_edges > 0 ? permuted_edges.edge_array[0] : NULL;
+    Conditions permutation_cond = cond;
+    try {
+        for (int i = first; i < num_permutations; i += step) {
+            if (i > first) {
+                edges_set.reset(permuted_edges, edges);
+                copy_edges(edges, permuted_edges);
+            }
+            stats[i] = statsCounter();
+            stats[i].num_swaps = num_swaps;
+            permutation_cond.seed = cond.seed + i;
+            swap_edges(permuted_edges, num_swaps, permutation_cond, &stats[i], edges_set);
+
+            if (!sink.ordered()) {
+                sink.write(i, packed_edges, edges.num_edges);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (failed)
+                    return;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return next_index == i || failed; });
+            if (failed)
+                return;
+            sink.write(i, packed_edges, edges.num_edges);
+            next_index++;
+            lock.unlock();
+            condition.notify_all();
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+        }
+        condition.notify_all();
+        throw;
+    }
+}
+
+/* `write_permutations` on `num_workers` threads. Worker `w` permutes its own
+ copy of the edges in its own bitset, taking permutations `w, w + num_workers,
+ ...`, so that ordered sinks hold back at most one permutation per worker. The
+ bitsets are built up front, and each takes up to `max_malloc` bytes. */
+static void write_permutations_parallel(Edges edges, int num_swaps, int num_permutations,
+                                        Conditions cond, unsigned long long int max_malloc,
+                                        PermutationSink &sink,
+                                        std::vector<statsCounter> &stats, int num_workers) {
+    std::vector<Edges> permuted_edges;
+    std::vector<BitSet> edges_sets;
+    for (int w = 0; w < num_workers; w++) {
+        permuted_edges.push_back(allocate_edges(edges.num_edges));
+        permuted_edges[w].max_id = edges.max_id;
+        copy_edges(edges, permuted_edges[w]);
+        edges_sets.push_back(BitSet(edges, max_malloc));
+    }
+
+    int next_index = 0;
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::exception_ptr> errors(num_workers);
+    auto run = [&](int w) {
+        try {
+            write_permutation_stride(edges, permuted_edges[w], edges_sets[w], w, num_workers,
+                                     num_swaps, num_permutations, cond, sink, stats,
+                                     next_index, failed, mutex, condition);
+        } catch (...) {
+            errors[w] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; w++) {
+        workers.push_back(std::thread(run, w));
+    }
+    run(0);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    for (int w = 0; w < num_workers; w++) {
+        edges_sets[w].free_array();
+        free_edges(permuted_edges[w]);
+    }
+    for (int w = 0; w < num_workers; w++) {
+        if (errors[w])
+            std::rethrow_exception(errors[w]);
+    }
+}
+
+/* Run `num_permutations` permutations of `edges`, using seed `cond.seed + i`
+ for permutation `i` as in `count_edge_occurrences`, and pass each permuted
+ network to `sink` straight from the packed edge buffer. `stats` receives the
+ statistics of each permutation.
+
+ With `background`, a writer thread takes each finished permutation while the
+ next one is swapped, so swapping and writing overlap. The swapping thread
+ waits only when the previous permutation is still being written.
+
+ With `num_threads` above 1, permutations are instead swapped on several
+ threads that write their own results, so `background` is not needed. */
+void write_permutations(Edges edges, int num_swaps, int num_permutations,
+                        Conditions cond, unsigned long long int max_malloc,
+                        PermutationSink &sink, bool background,
+                        std::vector<statsCounter> &stats, int num_threads) {
+    int num_workers = std::min(num_threads, num_permutations);
+    if (num_workers > 1) {
+        stats.resize(num_permutations);
+        write_permutations_parallel(edges, num_swaps, num_permutations, cond, max_malloc,
+                                    sink, stats, num_workers);
+        return;
+    }
+
+    Edges permuted_edges = allocate_edges(edges.num_edges);
+    permuted_edges.max_id = edges.max_id;
+    copy_edges(edges, permuted_edges);
+    BitSet edges_set = BitSet(edges, max_malloc);
+    size_t num_values = 2 * (size_t)edges.num_edges;
+    const int* packed_edges = edges.num_edges > 0 ? permuted_edges.edge_array[0] : NULL;
+
+    // State shared with the writer thread
+    std::vector<int> pending(num_values);
+    int pending_index = -1;
+    bool finished = false;
+    std::exception_ptr writer_error;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread writer;
+    if (background) {
+        writer = std::thread([&]() {
+            std::vector<int> writing(num_values);
+            while (true) {
+                int index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&]() { return pending_index >= 0 || finished; });
+                    if (pending_index < 0)
+                        return;
+                    index = pending_index;
+                    writing.swap(pending);
+                    pending_index = -1;
+                }
+                condition.notify_all();
+                try {
+                    sink.write(index, writing.data(), edges.num_edges);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    writer_error = std::current_exception();
+                    finished = true;
+                    condition.notify_all();
+                    return;
+                }
+            }
+        });
+    }
+
+    try {
+        stats.resize(num_permutations);
+        Conditions permutation_cond = cond;
+        for (int i = 0; i < num_permutations; i++) {
+            if (i > 0) {
+                edges_set.reset(permuted_edges, edges);
+                copy_edges(edges, permuted_edges);
+            }
+            stats[i] = statsCounter();
+            stats[i].num_swaps = num_swaps;
+            permutation_cond.seed = cond.seed + i;
+            swap_edges(permuted_edges, num_swaps, permutation_cond, &stats[i], edges_set);
+
+            if (!background) {
+                sink.write(i, packed_edges, edges.num_edges);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return pending_index < 0 || writer_error; });
+            if (writer_error)
+                break;
+            std::copy(packed_edges, packed_edges + num_values, pending.begin());
+            pending_index = i;
+            lock.unlock();
+            condition.notify_all();
+        }
+    } catch (...) {
+        if (background) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            condition.notify_all();
+            writer.join();
+        }
+        edges_set.free_array();
+        free_edges(permuted_edges);
+        throw;
+    }
+
+    if (background) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return pending_index < 0 || writer_error; });
+            finished = true;
+        }
+        condition.notify_all();
+        writer.join();
+    }
+    edges_set.free_array();
+    free_edges(permuted_edges);
+    if (writer_error)
+        std::rethrow_exception(writer_error);
+}
+
+// Whether packed `edges` contain the same (source, target) pair twice
+bool has_duplicate_edges(const int *edges, size_t num_edges) {
+    std::vector<unsigned long long> keys(num_edges);
+    for (size_t i = 0; i < num_edges; i++) {
+        keys[i] = ((unsigned long long)(unsigned int)edges[2 * i] << 32)
+                  | (unsigned int)edges[2 * i + 1];
+    }
+    std::sort(keys.begin(), keys.end());
+    return std::adjacent_find(keys.begin(), keys.end()) != keys.end();
+}
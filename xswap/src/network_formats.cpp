@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include "parallel_sort.h"
+#include "xswap.h"
+
+/* Build the compressed sparse structure of a (bi)adjacency matrix from packed
+ `(source, target)` pairs. With `by_column`, entries are grouped by target (CSC)
+ and `indices` holds sources; otherwise they are grouped by source (CSR). One
+ counting-sort pass places entries, including reverse edges if requested, and
+ each row or column is then sorted and deduplicated in place. `indptr` receives
+ `num_major + 1` offsets, and `data` the number of times each entry occurs. */
+void edges_to_compressed(const int *edges, size_t num_edges, int num_rows,
+                         int num_cols, bool add_reverse_edges, bool by_column,
+                         std::vector<long long> &indptr, std::vector<int> &indices,
+                         std::vector<int> &data) {
+    if (add_reverse_edges && num_rows != num_cols)
+        throw std::invalid_argument("Adding reverse edges requires a square shape.");
+    int num_major = by_column ? num_cols : num_rows;
+    int major_position = by_column ? 1 : 0;
+
+    // Count entries per row (or column)
+    std::vector<long long> counts(num_major + 1, 0);
+    for (size_t i = 0; i < num_edges; i++) {
+        int source = edges[2 * i];
+        int target = edges[2 * i + 1];
+        if (source < 0 || source >= num_rows || target < 0 || target >= num_cols)
+            throw std::out_of_range("Edge is outside the shape of the matrix.");
+        counts[edges[2 * i + major_position] + 1] += 1;
+        if (add_reverse_edges && source != target)
+            counts[edges[2 * i + 1 - major_position] + 1] += 1;
+    }
+    for (int i = 0; i < num_major; i++) {
+        counts[i + 1] += counts[i];
+    }
+
+    // Place entries
+    std::vector<int> unsorted(counts[num_major]);
+    std::vector<long long> next(counts.begin(), counts.end() - 1);
+    for (size_t i = 0; i < num_edges; i++) {
+        int major = edges[2 * i + major_position];
+        int minor = edges[2 * i + 1 - major_position];
+        unsorted[next[major]++] = minor;
+        if (add_reverse_edges && major != minor)
+            unsorted[next[minor]++] = major;
+    }
+
+    // Sort and deduplicate each row (or column), counting repeated entries
+    indptr.assign(num_major + 1, 0);
+    indices.clear();
+    indices.reserve(unsorted.size());
+    data.clear();
+    data.reserve(unsorted.size());
+    for (int i = 0; i < num_major; i++) {
+        std::vector<int>::iterator begin = unsorted.begin() + counts[i];
+        std::vector<int>::iterator end = unsorted.begin() + counts[i + 1];
+        std::sort(begin, end);
+        for (std::vector<int>::iterator it = begin; it != end; ++it) {
+            if (it != begin && *it == indices.back()) {
+                data.back() += 1;
+            } else {
+                indices.push_back(*it);
+                data.push_back(1);
+            }
+        }
+        indptr[i + 1] = indices.size();
+    }
+}
+
+/* Fill a bit-packed dense (bi)adjacency matrix. Each row takes
+ `ceil(num_cols / 8)` bytes and column `j` is bit `7 - j % 8` of byte `j / 8`,
+ the layout of `numpy.packbits(matrix, axis=1)`. `output` is zeroed first. */
+void edges_to_packed_matrix(const int *edges, size_t num_edges, int num_rows,
+                            int num_cols, bool add_reverse_edges,
+                            unsigned char *output) {
+    if (add_reverse_edges && num_rows != num_cols)
+        throw std::invalid_argument("Adding reverse edges requires a square shape.");
+    size_t row_bytes = ((size_t)num_cols + CHAR_BITS - 1) / CHAR_BITS;
+    std::memset(output, 0, row_bytes * num_rows);
+    for (size_t i = 0; i < num_edges; i++) {
+        int source = edges[2 * i];
+        int target = edges[2 * i + 1];
+        if (source < 0 || source >= num_rows || target < 0 || target >= num_cols)
+            throw std::out_of_range("Edge is outside the shape of the matrix.");
+        output[source * row_bytes + target / CHAR_BITS] |= 0x80 >> (target % CHAR_BITS);
+        if (add_reverse_edges)
+            output[target * row_bytes + source / CHAR_BITS] |= 0x80 >> (source % CHAR_BITS);
+    }
+}
+
+/* Power-law degrees of `num_nodes` nodes summing to exactly `num_stubs`. Node
+ `i` gets a share of the stubs proportional to `(i + 1)^(-1 / (exponent - 1))`,
+ the expected-degree weights whose degree distribution has tail exponent
+ `exponent`, rounded so that the cumulative degrees stay exact. */
+static std::vector<size_t> power_law_degrees(int num_nodes, size_t num_stubs, double exponent) {
+    std::vector<double> cumulative(num_nodes);
+    double total = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        total += std::pow(i + 1.0, -1.0 / (exponent - 1.0));
+        cumulative[i] = total;
+    }
+    std::vector<size_t> degrees(num_nodes);
+    size_t assigned = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        size_t through_i = i + 1 < num_nodes
+                           ? (size_t)(num_stubs * (cumulative[i] / total)) : num_stubs;
+        through_i = std::min(std::max(through_i, assigned), num_stubs);
+        degrees[i] = through_i - assigned;
+        assigned = through_i;
+    }
+    return degrees;
+}
+
+// A uniformly random permutation of `0, ..., size - 1`
+static std::vector<int> random_labels(int size, std::mt19937_64 &rng) {
+    std::vector<int> labels(size);
+    for (int i = 0; i < size; i++) {
+        labels[i] = i;
+    }
+    for (int i = size - 1; i > 0; i--) {
+        std::swap(labels[i], labels[rng() % ((unsigned long long)i + 1)]);
+    }
+    return labels;
+}
+
+/* Generate a random network with power-law degrees by the erased
+ configuration model, and write it to `edges` as packed `(source, target)`
+ pairs. Returns the number of edges.
+
+ `num_edges` stubs are spread over the sources and over the targets with
+ `power_law_degrees`, the target stubs are shuffled against the source stubs,
+ and node ids are shuffled so that degree does not follow id. Pairs that
+ XSwap would reject are then erased, so slightly fewer than `num_edges` edges
+ remain: duplicates, and for unipartite networks self-loops, plus for
+ undirected networks the reverse of another edge. Undirected edges are
+ written with `source < target`. Bipartite networks have `num_sources` and
+ `num_targets` nodes in separate id ranges; unipartite networks have
+ `num_sources` nodes.
+
+ The result depends only on the arguments other than `num_threads`, which
+ sets the threads used to sort. Generating takes 8 bytes per stub, plus the
+ 8 bytes per edge of the output. */
+size_t generate_power_law_edges(int num_sources, int num_targets, size_t num_edges,
+                                double exponent, bool bipartite, bool directed,
+                                unsigned long long seed, int num_threads,
+                                std::vector<int> &edges) {
+    if (!bipartite)
+        num_targets = num_sources;
+    if (num_sources < 1 || num_targets < 1)
+        throw std::invalid_argument("Networks need at least one source and one target node.");
+    if (!(exponent > 1))
+        throw std::invalid_argument("The degree exponent must be greater than 1.");
+    if (num_edges > (size_t)INT_MAX)
+        throw std::invalid_argument("Networks are limited to INT_MAX edges.");
+
+    std::mt19937_64 rng(seed);
+    std::vector<int> source_labels = random_labels(num_sources, rng);
+    std::vector<int> target_labels = bipartite ? random_labels(num_targets, rng) : source_labels;
+
+    // Targets in the high halves of the keys, shuffled, then sources in the
+    // low halves
+    std::vector<unsigned long long> keys(num_edges);
+    std::vector<size_t> degrees = power_law_degrees(num_targets, num_edges, exponent);
+    size_t position = 0;
+    for (int i = 0; i < num_targets; i++) {
+        for (size_t d = 0; d < degrees[i]; d++) {
+            keys[position++] = (unsigned long long)(unsigned int)target_labels[i] << 32;
+        }
+    }
+    for (size_t i = num_edges; i > 1; i--) {
+        std::swap(keys[i - 1], keys[rng() % i]);
+    }
+    if (bipartite)
+        degrees = power_law_degrees(num_sources, num_edges, exponent);
+    position = 0;
+    for (int i = 0; i < num_sources; i++) {
+        for (size_t d = 0; d < degrees[i]; d++) {
+            keys[position++] |= (unsigned int)source_labels[i];
+        }
+    }
+
+    // Erase rejected pairs, comparing undirected edges as (smaller, larger)
+    size_t num_kept = 0;
+    for (size_t i = 0; i < num_edges; i++) {
+        unsigned int source = (unsigned int)(keys[i] & 0xFFFFFFFFULL);
+        unsigned int target = (unsigned int)(keys[i] >> 32);
+        if (!bipartite && source == target)
+            continue;
+        if (!bipartite && !directed && source > target)
+            std::swap(source, target);
+        keys[num_kept++] = ((unsigned long long)source << 32) | target;
+    }
+    keys.resize(num_kept);
+    parallel_sort(keys, num_threads, 65536, std::less<unsigned long long>());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    edges.resize(2 * keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        edges[2 * i] = (int)(keys[i] >> 32);
+        edges[2 * i + 1] = (int)(keys[i] & 0xFFFFFFFFULL);
+    }
+    return keys.size();
+}
@@ -0,0 +1,48 @@
+#ifndef XSWAP_PARALLEL_SORT_H
+#define XSWAP_PARALLEL_SORT_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/* Sort `values` by `compare`, with contiguous ranges of at least `min_range`
+ values sorted on up to `num_threads` threads and merged pairwise in a tree.
+ Internal to the library, and not installed with `xswap.h`. */
+template <typename T, typename Compare>
+void parallel_sort(std::vector<T> &values, int num_threads, size_t min_range,
+                   Compare compare) {
+    size_t num_values = values.size();
+    int num_workers = (int)std::max((size_t)1, std::min((size_t)std::max(num_threads, 1),
+                                                        num_values / min_range));
+    std::vector<size_t> bounds(num_workers + 1);
+    for (int w = 0; w <= num_workers; w++) {
+        bounds[w] = num_values / num_workers * w + std::min((size_t)w, num_values % num_workers);
+    }
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; w++) {
+        workers.push_back(std::thread([&, w]() {
+            std::sort(values.begin() + bounds[w], values.begin() + bounds[w + 1], compare);
+        }));
+    }
+    std::sort(values.begin(), values.begin() + bounds[1], compare);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    for (int stride = 1; stride < num_workers; stride *= 2) {
+        std::vector<std::thread> mergers;
+        for (int w = 0; w + stride < num_workers; w += 2 * stride) {
+            size_t last = bounds[std::min(w + 2 * stride, num_workers)];
+            mergers.push_back(std::thread([&, w, stride, last]() {
+                std::inplace_merge(values.begin() + bounds[w],
+                                   values.begin() + bounds[w + stride],
+                                   values.begin() + last, compare);
+            }));
+        }
+        for (size_t m = 0; m < mergers.size(); m++) {
+            mergers[m].join();
+        }
+    }
+}
+
+#endif
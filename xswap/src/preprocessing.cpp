@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "parallel_sort.h"
+#include "xswap.h"
+
+static const unsigned long long EMPTY_SLOT = ~0ULL;
+
+static unsigned long long fnv1a_hash(const char *value, size_t length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)value[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+StringInterner::StringInterner() : slots(1024, EMPTY_SLOT) {
+    offsets.push_back(0);
+}
+
+/* Return the id of a string, adding it if it has not been seen. Ids are
+ consecutive in order of first appearance. Strings are copied into one arena
+ and found through an open-addressing table whose slots hold the id in the low
+ 32 bits and the top of the hash in the high 32 bits, so that most probes for
+ other strings are rejected without touching the arena. */
+int StringInterner::intern(const char *value, size_t length) {
+    unsigned long long hash = fnv1a_hash(value, length);
+    unsigned long long tag = hash & 0xFFFFFFFF00000000ULL;
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != EMPTY_SLOT) {
+        if ((slots[slot] & 0xFFFFFFFF00000000ULL) == tag) {
+            int id = (int)(slots[slot] & 0xFFFFFFFFULL);
+            if (string_length(id) == length && memcmp(string_data(id), value, length) == 0)
+                return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+    int id = (int)hashes.size();
+    slots[slot] = tag | (unsigned int)id;
+    hashes.push_back(hash);
+    arena.insert(arena.end(), value, value + length);
+    offsets.push_back(arena.size());
+
+    // Keep the table at most half full
+    if (2 * hashes.size() > slots.size()) {
+        slots.assign(2 * slots.size(), EMPTY_SLOT);
+        mask = slots.size() - 1;
+        for (size_t i = 0; i < hashes.size(); i++) {
+            slot = hashes[i] & mask;
+            while (slots[slot] != EMPTY_SLOT)
+                slot = (slot + 1) & mask;
+            slots[slot] = (hashes[i] & 0xFFFFFFFF00000000ULL) | (unsigned int)i;
+        }
+    }
+    return id;
+}
+
+/* Byte-wise order of the interned strings. For UTF-8, this is the code point
+ order that Python uses to sort `str`. */
+bool StringInterner::less(int a, int b) const {
+    size_t length_a = string_length(a);
+    size_t length_b = string_length(b);
+    int order = memcmp(string_data(a), string_data(b), std::min(length_a, length_b));
+    return order < 0 || (order == 0 && length_a < length_b);
+}
+
+/* Ids of the interned strings in sorted order, sorted on up to `num_threads`
+ threads. */
+std::vector<int> StringInterner::sorted_ids(int num_threads) const {
+    int num_strings = size();
+    std::vector<int> ids(num_strings);
+    for (int i = 0; i < num_strings; i++) {
+        ids[i] = i;
+    }
+    auto compare = [this](int a, int b) { return less(a, b); };
+
+    parallel_sort(ids, num_threads, 1024, compare);
+    return ids;
+}
+
+/* Replace the interned ids `node_ids[0], node_ids[stride], ...` with the
+ sorted index of their string, the id assigned by
+ `xswap.preprocessing.map_str_edges`, and return the ids of the strings in
+ sorted order. */
+std::vector<int> assign_sorted_ids(const StringInterner &interner, int *node_ids,
+                                   size_t num_ids, size_t stride, int num_threads) {
+    std::vector<int> sorted = interner.sorted_ids(num_threads);
+    std::vector<int> rank(sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        rank[sorted[i]] = (int)i;
+    }
+
+    int num_workers = (int)std::max((size_t)1, std::min((size_t)std::max(num_threads, 1),
+                                                        num_ids / 65536));
+    auto relabel = [&](int w) {
+        size_t last = num_ids * (w + 1) / num_workers;
+        for (size_t i = num_ids * w / num_workers; i < last; i++) {
+            node_ids[i * stride] = rank[node_ids[i * stride]];
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; w++) {
+        workers.push_back(std::thread(relabel, w));
+    }
+    relabel(0);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    return sorted;
+}
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "xswap.h"
+
+PermutationAccumulator::PermutationAccumulator(bool add_reverse_edges)
+    : add_reverse_edges(add_reverse_edges) {}
+
+/* Visit every entry of the permuted network's matrix once. When reverse edges
+ are added, `(b, a)` is visited for an edge `(a, b)` unless `(b, a)` is itself
+ an edge, which matches `edges_to_matrix(..., add_reverse_edges=True)`. */
+void PermutationAccumulator::add_permutation(Edges edges, BitSet &edges_set) {
+    for (int i = 0; i < edges.num_edges; i++) {
+        int* edge = edges.edge_array[i];
+        add_entry(edge[0], edge[1]);
+        if (add_reverse_edges && edge[0] != edge[1]) {
+            int reversed[2] = { edge[1], edge[0] };
+            if (!edges_set.contains(reversed))
+                add_entry(edge[1], edge[0]);
+        }
+    }
+    finish_permutation();
+}
+
+OccurrenceCounter::OccurrenceCounter(int num_rows, int num_cols, bool add_reverse_edges,
+                                     long long *dense_counts,
+                                     unsigned long long int max_copy_bytes)
+    : PermutationAccumulator(add_reverse_edges), num_rows(num_rows),
+      num_cols(num_cols), dense_counts(dense_counts), max_copy_bytes(max_copy_bytes) {
+    if (add_reverse_edges && num_rows != num_cols)
+        throw std::invalid_argument("Adding reverse edges requires a square shape.");
+}
+
+void OccurrenceCounter::add_entry(int source, int target) {
+    if (source < 0 || source >= num_rows || target < 0 || target >= num_cols)
+        throw std::out_of_range("Edge is outside the shape of the occurrence matrix.");
+    unsigned long long key = (unsigned long long)source * num_cols + target;
+    if (dense_counts != NULL) {
+        dense_counts[key] += 1;
+    } else {
+        sparse_counts[key] += 1;
+    }
+}
+
+/* Workers count densely only if a dense array fits in `max_copy_bytes`, so
+ that memory does not grow with the number of threads by a whole matrix each.
+ Otherwise they count sparsely, and their counts are merged into the dense
+ array. */
+PermutationAccumulator* OccurrenceCounter::empty_copy() {
+    OccurrenceCounter* copy = new OccurrenceCounter(num_rows, num_cols, add_reverse_edges,
+                                                    NULL, max_copy_bytes);
+    size_t num_bytes = sizeof(long long) * (size_t)num_rows * num_cols;
+    if (dense_counts != NULL && num_bytes <= max_copy_bytes) {
+        copy->owned_dense_counts.assign((size_t)num_rows * num_cols, 0);
+        copy->dense_counts = copy->owned_dense_counts.data();
+    }
+    return copy;
+}
+
+void OccurrenceCounter::add_count(unsigned long long key, long long count) {
+    if (dense_counts != NULL) {
+        dense_counts[key] += count;
+    } else {
+        sparse_counts[key] += count;
+    }
+}
+
+void OccurrenceCounter::merge(PermutationAccumulator &other) {
+    OccurrenceCounter &other_counter = dynamic_cast<OccurrenceCounter&>(other);
+    if (other_counter.dense_counts != NULL) {
+        for (size_t i = 0; i < (size_t)num_rows * num_cols; i++) {
+            if (other_counter.dense_counts[i] != 0)
+                add_count(i, other_counter.dense_counts[i]);
+        }
+    } else {
+        std::unordered_map<unsigned long long, long long>::iterator it;
+        for (it = other_counter.sparse_counts.begin(); it != other_counter.sparse_counts.end(); ++it) {
+            add_count(it->first, it->second);
+        }
+    }
+}
+
+size_t OccurrenceCounter::num_nonzero() {
+    if (dense_counts == NULL)
+        return sparse_counts.size();
+    size_t num_nonzero = 0;
+    for (size_t i = 0; i < (size_t)num_rows * num_cols; i++) {
+        if (dense_counts[i] != 0)
+            num_nonzero += 1;
+    }
+    return num_nonzero;
+}
+
+// Write nonzero counts in row-major order. Arrays need `num_nonzero()` elements.
+void OccurrenceCounter::to_coo(int *rows, int *cols, long long *counts) {
+    std::vector<std::pair<unsigned long long, long long> > entries;
+    if (dense_counts == NULL) {
+        entries.assign(sparse_counts.begin(), sparse_counts.end());
+        std::sort(entries.begin(), entries.end());
+    } else {
+        for (size_t i = 0; i < (size_t)num_rows * num_cols; i++) {
+            if (dense_counts[i] != 0)
+                entries.push_back(std::make_pair(i, dense_counts[i]));
+        }
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        rows[i] = entries[i].first / num_cols;
+        cols[i] = entries[i].first % num_cols;
+        counts[i] = entries[i].second;
+    }
+}
+
+// Map each node to the position of its degree among the sorted distinct degrees
+static void index_degrees(int *degrees, int num_nodes, std::vector<int> &values,
+                          std::vector<long long> &nodes_per_value,
+                          std::vector<int> &index) {
+    values.assign(degrees, degrees + num_nodes);
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    nodes_per_value.assign(values.size(), 0);
+    index.resize(num_nodes);
+    for (int i = 0; i < num_nodes; i++) {
+        index[i] = std::lower_bound(values.begin(), values.end(), degrees[i]) - values.begin();
+        nodes_per_value[index[i]] += 1;
+    }
+}
+
+DegreePairCounter::DegreePairCounter(int *source_degrees, int num_rows,
+                                     int *target_degrees, int num_cols,
+                                     bool add_reverse_edges)
+    : PermutationAccumulator(add_reverse_edges) {
+    index_degrees(source_degrees, num_rows, source_degree_values,
+                  source_degree_nodes, source_degree_index);
+    index_degrees(target_degrees, num_cols, target_degree_values,
+                  target_degree_nodes, target_degree_index);
+    counts.assign(source_degree_values.size() * target_degree_values.size(), 0);
+    squared_counts.assign(counts.size(), 0);
+    permutation_counts.assign(counts.size(), 0);
+}
+
+void DegreePairCounter::add_entry(int source, int target) {
+    if (source < 0 || source >= (int)source_degree_index.size() ||
+        target < 0 || target >= (int)target_degree_index.size())
+        throw std::out_of_range("Edge is outside the shape of the degree arrays.");
+    size_t pair = (size_t)source_degree_index[source] * target_degree_values.size() +
+                  target_degree_index[target];
+    if (permutation_counts[pair] == 0)
+        touched_pairs.push_back(pair);
+    permutation_counts[pair] += 1;
+}
+
+// Only degree pairs with edges in this permutation are visited
+void DegreePairCounter::finish_permutation() {
+    for (size_t i = 0; i < touched_pairs.size(); i++) {
+        size_t pair = touched_pairs[i];
+        counts[pair] += permutation_counts[pair];
+        squared_counts[pair] += permutation_counts[pair] * permutation_counts[pair];
+        permutation_counts[pair] = 0;
+    }
+    touched_pairs.clear();
+}
+
+PermutationAccumulator* DegreePairCounter::empty_copy() {
+    DegreePairCounter* copy = new DegreePairCounter(*this);
+    copy->counts.assign(counts.size(), 0);
+    copy->squared_counts.assign(counts.size(), 0);
+    return copy;
+}
+
+void DegreePairCounter::merge(PermutationAccumulator &other) {
+    DegreePairCounter &other_counter = dynamic_cast<DegreePairCounter&>(other);
+    for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] += other_counter.counts[i];
+        squared_counts[i] += other_counter.squared_counts[i];
+    }
+}
+
+/* `queries` holds `num_queries` (source, target) pairs. Repeated queries share
+ a counter. */
+QueryCounter::QueryCounter(int *source_degrees, int num_rows, int *target_degrees,
+                           int num_cols, bool add_reverse_edges, int *queries,
+                           int num_queries)
+    : DegreePairCounter(source_degrees, num_rows, target_degrees, num_cols,
+                        add_reverse_edges),
+      num_cols(num_cols) {
+    slot_of_query.resize(num_queries);
+    for (int i = 0; i < num_queries; i++) {
+        int source = queries[2 * (size_t)i];
+        int target = queries[2 * (size_t)i + 1];
+        if (source < 0 || source >= num_rows || target < 0 || target >= num_cols)
+            throw std::out_of_range("Query node pair is outside the shape of the network.");
+        unsigned long long key = (unsigned long long)source * num_cols + target;
+        std::unordered_map<unsigned long long, size_t>::iterator slot = query_slots.find(key);
+        if (slot == query_slots.end()) {
+            slot = query_slots.insert(std::make_pair(key, slot_counts.size())).first;
+            slot_counts.push_back(0);
+        }
+        slot_of_query[i] = slot->second;
+    }
+}
+
+void QueryCounter::add_entry(int source, int target) {
+    DegreePairCounter::add_entry(source, target);
+    unsigned long long key = (unsigned long long)source * num_cols + target;
+    std::unordered_map<unsigned long long, size_t>::iterator slot = query_slots.find(key);
+    if (slot != query_slots.end())
+        slot_counts[slot->second] += 1;
+}
+
+PermutationAccumulator* QueryCounter::empty_copy() {
+    QueryCounter* copy = new QueryCounter(*this);
+    copy->counts.assign(counts.size(), 0);
+    copy->squared_counts.assign(counts.size(), 0);
+    copy->slot_counts.assign(slot_counts.size(), 0);
+    return copy;
+}
+
+void QueryCounter::merge(PermutationAccumulator &other) {
+    DegreePairCounter::merge(other);
+    QueryCounter &other_counter = dynamic_cast<QueryCounter&>(other);
+    for (size_t i = 0; i < slot_counts.size(); i++) {
+        slot_counts[i] += other_counter.slot_counts[i];
+    }
+}
+
+// Write the count of every query, in the order the queries were given
+void QueryCounter::query_counts(long long *counts) {
+    for (size_t i = 0; i < slot_of_query.size(); i++) {
+        counts[i] = slot_counts[slot_of_query[i]];
+    }
+}
+
+/* Run permutations `first` to `last` of `edges`, using seed `cond.seed + i` for
+ permutation `i`, and add each permuted network to `accumulator`. `edges_set`
+ must contain exactly `edges` and is restored between permutations, so a
+ single working copy of the edges and a single bitset serve the whole range. */
+static void run_permutations(Edges edges, int num_swaps, int first, int last,
+                             Conditions cond, BitSet &edges_set,
+                             PermutationAccumulator &accumulator) {
+    Edges permuted_edges = allocate_edges(edges.num_edges);
+    permuted_edges.max_id = edges.max_id;
+    copy_edges(edges, permuted_edges);
+
+    try {
+        Conditions permutation_cond = cond;
+        for (int i = first; i < last; i++) {
+            if (i > first) {
+                edges_set.reset(permuted_edges, edges);
+                copy_edges(edges, permuted_edges);
+            }
+            statsCounter stats;
+            stats.num_swaps = num_swaps;
+            permutation_cond.seed = cond.seed + i;
+            swap_edges(permuted_edges, num_swaps, permutation_cond, &stats, edges_set);
+            accumulator.add_permutation(permuted_edges, edges_set);
+        }
+    } catch (...) {
+        free_edges(permuted_edges);
+        throw;
+    }
+    free_edges(permuted_edges);
+}
+
+/* Run `num_permutations` permutations of `edges`, using seeds `cond.seed`,
+ `cond.seed + 1`, etc., and add each permuted network to `accumulator`.
+
+ With several threads, each worker runs a contiguous range of seeds with its
+ own bitset into a private copy of the accumulator, and the copies are summed
+ pairwise in a tree. Counts are integers, so the result is identical for any
+ number of threads. */
+void count_edge_occurrences(Edges edges, int num_swaps, int num_permutations,
+                            Conditions cond, unsigned long long int max_malloc,
+                            PermutationAccumulator &accumulator, int num_threads) {
+    int num_workers = std::max(1, std::min(num_threads, num_permutations));
+
+    std::vector<BitSet> edge_sets;
+    std::vector<std::unique_ptr<PermutationAccumulator> > worker_copies;
+    std::vector<PermutationAccumulator*> partials;
+    try {
+        for (int w = 0; w < num_workers; w++) {
+            edge_sets.push_back(BitSet(edges, max_malloc));
+            if (w == 0) {
+                partials.push_back(&accumulator);
+            } else {
+                worker_copies.push_back(std::unique_ptr<PermutationAccumulator>(
+                    accumulator.empty_copy()));
+                partials.push_back(worker_copies.back().get());
+            }
+        }
+
+        if (num_workers == 1) {
+            run_permutations(edges, num_swaps, 0, num_permutations, cond,
+                             edge_sets[0], accumulator);
+        } else {
+            std::vector<std::exception_ptr> errors(num_workers);
+            std::vector<std::thread> workers;
+            for (int w = 0; w < num_workers; w++) {
+                int first = (int)((long long)num_permutations * w / num_workers);
+                int last = (int)((long long)num_permutations * (w + 1) / num_workers);
+                workers.push_back(std::thread([&, w, first, last]() {
+                    try {
+                        run_permutations(edges, num_swaps, first, last, cond,
+                                         edge_sets[w], *partials[w]);
+                    } catch (...) {
+                        errors[w] = std::current_exception();
+                    }
+                }));
+            }
+            for (size_t w = 0; w < workers.size(); w++) {
+                workers[w].join();
+            }
+            for (int w = 0; w < num_workers; w++) {
+                if (errors[w])
+                    std::rethrow_exception(errors[w]);
+            }
+
+            // Tree reduction into `accumulator`, merging pairs in parallel
+            for (int stride = 1; stride < num_workers; stride *= 2) {
+                std::vector<std::thread> mergers;
+                for (int w = 0; w + stride < num_workers; w += 2 * stride) {
+                    mergers.push_back(std::thread([&, w, stride]() {
+                        partials[w]->merge(*partials[w + stride]);
+                    }));
+                }
+                for (size_t m = 0; m < mergers.size(); m++) {
+                    mergers[m].join();
+                }
+            }
+        }
+    } catch (...) {
+        for (size_t w = 0; w < edge_sets.size(); w++) {
+            edge_sets[w].free_array();
+        }
+        throw;
+    }
+    for (size_t w = 0; w < edge_sets.size(); w++) {
+        edge_sets[w].free_array();
+    }
+}
+
+/* Evaluate the approximate XSwap prior (see `xswap.prior.approximate_xswap_prior`)
+ for every pair of the given source and target degrees, in row-major order. The
+ inner loop has no branches, so it is vectorized by the compiler. */
+void approximate_degree_pair_priors(const int *source_degrees, int num_source_values,
+                                    const int *target_degrees, int num_target_values,
+                                    double num_edges, double *output) {
+    for (int i = 0; i < num_source_values; i++) {
+        double source_degree = source_degrees[i];
+        double *output_row = output + (size_t)i * num_target_values;
+        for (int j = 0; j < num_target_values; j++) {
+            double target_degree = target_degrees[j];
+            double degree_product = source_degree * target_degree;
+            double remaining = num_edges - source_degree - target_degree + 1;
+            output_row[j] = degree_product / std::sqrt(
+                degree_product * degree_product + remaining * remaining);
+        }
+    }
+}
+
+/* Fill the rows `row_start` to `row_end` of a node-pair matrix with values of a
+ row-major degree-pair `table`. `source_index` and `target_index` give the
+ position of each node's degree in the table, so `output` receives
+ `(row_end - row_start) * num_cols` values in row-major order. */
+template <typename T>
+static void scatter_values(const double *table, int num_target_values,
+                           const int *source_index, const int *target_index,
+                           int num_cols, int row_start, int row_end, T *output) {
+    for (int row = row_start; row < row_end; row++) {
+        const double *table_row = table + (size_t)source_index[row] * num_target_values;
+        T *output_row = output + (size_t)(row - row_start) * num_cols;
+        for (int col = 0; col < num_cols; col++) {
+            output_row[col] = (T)table_row[target_index[col]];
+        }
+    }
+}
+
+void scatter_degree_pair_values(const double *table, int num_target_values,
+                                const int *source_index, const int *target_index,
+                                int num_cols, int row_start, int row_end,
+                                double *output) {
+    scatter_values(table, num_target_values, source_index, target_index,
+                   num_cols, row_start, row_end, output);
+}
+
+void scatter_degree_pair_values(const double *table, int num_target_values,
+                                const int *source_index, const int *target_index,
+                                int num_cols, int row_start, int row_end,
+                                float *output) {
+    scatter_values(table, num_target_values, source_index, target_index,
+                   num_cols, row_start, row_end, output);
+}
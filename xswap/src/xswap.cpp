@@ -1,11 +1,135 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <random>
+#include <thread>
 #include "xswap.h"
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Edges are stored contiguously, with `edge_array[i]` pointing into the block
+Edges allocate_edges(int num_edges) {
+    Edges edges;
+    edges.edge_array = (int**)malloc(sizeof(int*) * num_edges);
+    int* edge_block = NULL;
+    if (num_edges > 0)
+        edge_block = (int*)malloc(sizeof(int) * 2 * (size_t)num_edges);
+    for (int i = 0; i < num_edges; i++) {
+        edges.edge_array[i] = edge_block + 2 * (size_t)i;
+    }
+    edges.num_edges = num_edges;
+    edges.max_id = 0;
+    return edges;
+}
+
+void copy_edges(Edges source, Edges destination) {
+    for (int i = 0; i < source.num_edges; i++) {
+        std::memcpy(destination.edge_array[i], source.edge_array[i], sizeof(int) * 2);
+    }
+}
+
+void free_edges(Edges edges) {
+    if (edges.num_edges > 0)
+        free(edges.edge_array[0]);
+    free(edges.edge_array);
+}
+
+HardwareCounter::HardwareCounter(HardwareEvent event) : fd(-1) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event == CPU_CYCLES ? PERF_COUNT_HW_CPU_CYCLES : PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+HardwareCounter::~HardwareCounter() {
+#ifdef __linux__
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+void HardwareCounter::start() {
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+long long HardwareCounter::stop() {
+#ifdef __linux__
+    long long count;
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) == sizeof(count))
+            return count;
+    }
+#endif
+    return -1;
+}
+
+// Each rejected swap is counted for exactly one reason
+int accepted_swaps(const statsCounter &stats) {
+    return stats.num_swaps - stats.same_edge - stats.self_loop - stats.duplicate
+           - stats.undir_duplicate - stats.excluded;
+}
+
 void swap_edges(Edges edges, int num_swaps, Conditions cond, statsCounter *stats,
-                unsigned long long int max_malloc) {
-    // Initialize bitset for possible edges
+                unsigned long long int max_malloc, SwapProfile *profile) {
+    if (profile == NULL) {
+        // Initialize bitset for possible edges
+        BitSet edges_set = BitSet(edges, max_malloc);
+        swap_edges(edges, num_swaps, cond, stats, edges_set);
+        edges_set.free_array();
+        return;
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
     BitSet edges_set = BitSet(edges, max_malloc);
+    clock::time_point built = clock::now();
+    profile->bitset_seconds = std::chrono::duration<double>(built - start).count();
+    profile->roaring = edges_set.compressed();
+    profile->bitset_bytes = edges_set.size_in_bytes();
 
+    std::unique_ptr<HardwareCounter> cycles, cache_misses;
+    if (profile->hardware_counters) {
+        cycles.reset(new HardwareCounter(CPU_CYCLES));
+        cache_misses.reset(new HardwareCounter(CACHE_MISSES));
+        cycles->start();
+        cache_misses->start();
+    }
+    clock::time_point swap_start = clock::now();
+    swap_edges(edges, num_swaps, cond, stats, edges_set);
+    profile->swap_seconds = std::chrono::duration<double>(clock::now() - swap_start).count();
+    if (profile->hardware_counters) {
+        profile->cache_misses = cache_misses->stop();
+        profile->cycles = cycles->stop();
+    }
+    edges_set.free_array();
+}
+
+/* Permute `edges` using an existing bitset that contains exactly `edges`. Lets
+ callers running many permutations of one graph reuse a single allocation,
+ restoring it between runs with `BitSet::reset`. */
+void swap_edges(Edges edges, int num_swaps, Conditions cond, statsCounter *stats,
+                BitSet &edges_set) {
     // Initialize unbiased random number generator
     std::mt19937 rng(cond.seed);
     std::uniform_int_distribution<int> uni(0, edges.num_edges - 1);
@@ -43,10 +167,74 @@ void swap_edges(Edges edges, int num_swaps, Conditions cond, statsCounter *stats
             edges_set.add(new_edge_b);
         }
     }
-    edges_set.free_array();
 }
 
-bool is_valid_edge(int *new_edge, BitSet edges_set, Conditions valid_conditions,
+/* Permute each of `networks` in place, as `swap_edges` with its own number
+ of swaps and conditions, on a pool of `num_threads` threads. Networks are
+ taken largest first from a shared queue, so that the largest ones start
+ immediately and the small ones fill the remaining threads. Each network is
+ permuted exactly as by a single `swap_edges` call, so results do not depend
+ on the number of threads.
+
+ Each running network has its own bitset of up to `max_malloc` bytes.
+ Warnings from the workers are emitted on the calling thread once all
+ networks are permuted. */
+void permute_networks(std::vector<Edges> &networks, const std::vector<int> &num_swaps,
+                      const std::vector<Conditions> &conds, unsigned long long int max_malloc,
+                      int num_threads, std::vector<statsCounter> &stats) {
+    size_t num_networks = networks.size();
+    std::vector<size_t> order(num_networks);
+    for (size_t i = 0; i < num_networks; i++) {
+        order[i] = i;
+    }
+    // Swapping takes time in proportion to the attempts and building the
+    // bitset in proportion to the edges
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return (long long)num_swaps[a] + networks[a].num_edges
+               > (long long)num_swaps[b] + networks[b].num_edges;
+    });
+
+    stats.assign(num_networks, statsCounter());
+    int num_workers = (int)std::max((size_t)1, std::min((size_t)std::max(num_threads, 1),
+                                                        num_networks));
+    std::atomic<size_t> next_network(0);
+    std::vector<std::exception_ptr> errors(num_workers);
+    std::vector<std::vector<std::string> > warnings(num_workers);
+    auto run = [&](int w) {
+        WarningCapture capture(&warnings[w]);
+        try {
+            size_t position;
+            while ((position = next_network++) < num_networks) {
+                size_t i = order[position];
+                stats[i].num_swaps = num_swaps[i];
+                swap_edges(networks[i], num_swaps[i], conds[i], &stats[i], max_malloc);
+            }
+        } catch (...) {
+            errors[w] = std::current_exception();
+            next_network = num_networks;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; w++) {
+        workers.push_back(std::thread(run, w));
+    }
+    run(0);
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    for (int w = 0; w < num_workers; w++) {
+        for (size_t m = 0; m < warnings[w].size(); m++) {
+            emit_warning(warnings[w][m].c_str());
+        }
+    }
+    for (int w = 0; w < num_workers; w++) {
+        if (errors[w])
+            std::rethrow_exception(errors[w]);
+    }
+}
+
+bool is_valid_edge(int *new_edge, BitSet &edges_set, Conditions valid_conditions,
                    statsCounter *stats) {
     // New edge would be a self-loop
     if (!valid_conditions.allow_self_loop && new_edge[0] == new_edge[1]) {
@@ -74,7 +262,7 @@ bool is_valid_edge(int *new_edge, BitSet edges_set, Conditions valid_conditions,
     return true;
 }
 
-bool is_valid_swap(int **new_edges, BitSet edges_set, Conditions valid_conditions,
+bool is_valid_swap(int **new_edges, BitSet &edges_set, Conditions valid_conditions,
                    statsCounter *stats) {
     for (int i = 0; i < 2; i++) {
         bool is_valid = is_valid_edge(new_edges[i], edges_set, valid_conditions, stats);
@@ -1,8 +1,62 @@
-#include <Python.h>
+#ifndef XSWAP_XSWAP_H
+#define XSWAP_XSWAP_H
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "../lib/roaring.hh"
 
 extern int CHAR_BITS;
 
+// Diagnostics from the engine, such as falling back to the slower Roaring
+// bitset. By default, warnings are written to stderr; `set_warning_handler`
+// returns the previous handler. The handler is only called on the thread that
+// called into the engine: multithreaded functions build their bitsets, which
+// is where warnings come from, on that thread, or collect the warnings of
+// their workers with `WarningCapture` and emit them there.
+typedef void (*WarningHandler)(const char *message);
+
+WarningHandler set_warning_handler(WarningHandler handler);
+
+void emit_warning(const char *message);
+
+// While it exists, collects the warnings emitted on the thread that created
+// it instead of passing them to the handler. Worker threads use it so that
+// their warnings can be emitted later from the calling thread.
+class WarningCapture
+{
+    public:
+        WarningCapture(std::vector<std::string> *messages);
+        ~WarningCapture();
+
+    private:
+        std::vector<std::string>* previous;
+};
+
+enum HardwareEvent { CPU_CYCLES, CACHE_MISSES };
+
+// Hardware event counter for the calling thread, where Linux perf events are
+// available. `stop` returns the count since `start`, or -1 if unavailable.
+class HardwareCounter
+{
+    public:
+        HardwareCounter(HardwareEvent event);
+        ~HardwareCounter();
+        bool available() const { return fd >= 0; }
+        void start();
+        long long stop();
+
+    private:
+        int fd;
+        HardwareCounter(const HardwareCounter&);
+        HardwareCounter& operator=(const HardwareCounter&);
+};
+
 struct Edges {
     int** edge_array;
     int num_edges;
@@ -18,6 +72,8 @@ class RoaringBitSet
         bool contains(int *edge);
         void add(int *edge);
         void remove(int *edge);
+        void reset(Edges current_edges, Edges original_edges);
+        size_t size_in_bytes() const;
 
     private:
         Roaring bitmap;
@@ -33,7 +89,9 @@ class UncompressedBitSet
         bool contains(int *edge);
         void add(int *edge);
         void remove(int *edge);
+        void reset(Edges current_edges, Edges original_edges);
         void free_array();
+        size_t size_in_bytes() const;
 
     private:
         char* bitset;
@@ -52,8 +110,11 @@ class BitSet
         bool contains(int *edge);
         void add(int *edge);
         void remove(int *edge);
+        void reset(Edges current_edges, Edges original_edges);
         void free_array();
-        PyObject* runtime_warning_roaring(void);
+        void runtime_warning_roaring(void);
+        bool compressed() const { return use_compressed; }
+        size_t size_in_bytes() const;
         UncompressedBitSet uncompressed_set;
 
     private:
@@ -70,6 +131,22 @@ struct statsCounter {
     int excluded = 0;
 };
 
+// Optional measurements of a `swap_edges` call, in seconds. Hardware counts
+// around the swap loop are collected if `hardware_counters` is set, and are -1
+// otherwise or where perf events are unavailable.
+struct SwapProfile {
+    bool hardware_counters = false;
+    double bitset_seconds = 0;
+    double swap_seconds = 0;
+    bool roaring = false;
+    size_t bitset_bytes = 0;
+    long long cycles = -1;
+    long long cache_misses = -1;
+};
+
+// Swaps not rejected for any of the reasons counted in `stats`
+int accepted_swaps(const statsCounter &stats);
+
 struct Conditions {
     int seed;
     bool allow_antiparallel;
@@ -79,11 +156,316 @@ struct Conditions {
 
 size_t cantor_pair(int* edge);
 
+Edges allocate_edges(int num_edges);
+
+void copy_edges(Edges source, Edges destination);
+
+void free_edges(Edges edges);
+
+void swap_edges(Edges edges, int num_swaps, Conditions cond, statsCounter *stats,
+                unsigned long long int max_malloc, SwapProfile *profile = NULL);
+
 void swap_edges(Edges edges, int num_swaps, Conditions cond, statsCounter *stats,
-                unsigned long long int max_malloc);
+                BitSet &edges_set);
+
+void permute_networks(std::vector<Edges> &networks, const std::vector<int> &num_swaps,
+                      const std::vector<Conditions> &conds, unsigned long long int max_malloc,
+                      int num_threads, std::vector<statsCounter> &stats);
 
-bool is_valid_edge(int *edge, BitSet edges_set, Conditions cond,
+bool is_valid_edge(int *edge, BitSet &edges_set, Conditions cond,
                    statsCounter *stats);
 
-bool is_valid_swap(int **new_edges, BitSet edges_set, Conditions cond,
+bool is_valid_swap(int **new_edges, BitSet &edges_set, Conditions cond,
                    statsCounter *stats);
+
+// Receives every permuted network produced by `count_edge_occurrences`.
+// `add_permutation` visits the entries of the permuted (bi)adjacency matrix and
+// passes each to `add_entry`, then calls `finish_permutation`. For parallel runs, `empty_copy` creates a private
+// accumulator with zero counts for each worker and `merge` adds one into another.
+class PermutationAccumulator
+{
+    public:
+        PermutationAccumulator(bool add_reverse_edges);
+        virtual ~PermutationAccumulator() {}
+        void add_permutation(Edges edges, BitSet &edges_set);
+        virtual void add_entry(int source, int target) = 0;
+        virtual void finish_permutation() {}
+        virtual PermutationAccumulator* empty_copy() = 0;
+        virtual void merge(PermutationAccumulator &other) = 0;
+
+    protected:
+        bool add_reverse_edges;
+};
+
+// Number of permutations in which each node pair was an edge. Counts go to a
+// caller-provided dense row-major array if given, else to a hash keyed by
+// `source * num_cols + target`. Parallel workers use private dense arrays of
+// at most `max_copy_bytes`, and hashes for larger matrices.
+class OccurrenceCounter : public PermutationAccumulator
+{
+    public:
+        OccurrenceCounter(int num_rows, int num_cols, bool add_reverse_edges,
+                          long long *dense_counts = NULL,
+                          unsigned long long int max_copy_bytes = ULLONG_MAX);
+        void add_entry(int source, int target);
+        PermutationAccumulator* empty_copy();
+        void merge(PermutationAccumulator &other);
+        size_t num_nonzero();
+        void to_coo(int *rows, int *cols, long long *counts);
+
+    private:
+        void add_count(unsigned long long key, long long count);
+        int num_rows;
+        int num_cols;
+        long long *dense_counts;
+        unsigned long long int max_copy_bytes;
+        std::vector<long long> owned_dense_counts;
+        std::unordered_map<unsigned long long, long long> sparse_counts;
+};
+
+// Number of permuted edges between nodes of each (source degree, target degree)
+// pair, and the sum over permutations of the squared per-permutation number,
+// for estimating the variance of the prior. Memory is linear in the number of
+// nodes and distinct degree pairs.
+class DegreePairCounter : public PermutationAccumulator
+{
+    public:
+        DegreePairCounter(int *source_degrees, int num_rows, int *target_degrees,
+                          int num_cols, bool add_reverse_edges);
+        virtual void add_entry(int source, int target);
+        void finish_permutation();
+        virtual PermutationAccumulator* empty_copy();
+        virtual void merge(PermutationAccumulator &other);
+        std::vector<int> source_degree_values;
+        std::vector<int> target_degree_values;
+        std::vector<long long> source_degree_nodes;
+        std::vector<long long> target_degree_nodes;
+        std::vector<long long> counts;
+        std::vector<long long> squared_counts;
+
+    private:
+        std::vector<int> source_degree_index;
+        std::vector<int> target_degree_index;
+        std::vector<long long> permutation_counts;
+        std::vector<size_t> touched_pairs;
+};
+
+// Degree-pair counts plus the number of permutations in which each of a set of
+// query node pairs was an edge. Memory is linear in the number of queries.
+class QueryCounter : public DegreePairCounter
+{
+    public:
+        QueryCounter(int *source_degrees, int num_rows, int *target_degrees,
+                     int num_cols, bool add_reverse_edges, int *queries,
+                     int num_queries);
+        void add_entry(int source, int target);
+        PermutationAccumulator* empty_copy();
+        void merge(PermutationAccumulator &other);
+        void query_counts(long long *counts);
+
+    private:
+        int num_cols;
+        std::unordered_map<unsigned long long, size_t> query_slots;
+        std::vector<size_t> slot_of_query;
+        std::vector<long long> slot_counts;
+};
+
+void count_edge_occurrences(Edges edges, int num_swaps, int num_permutations,
+                            Conditions cond, unsigned long long int max_malloc,
+                            PermutationAccumulator &accumulator, int num_threads = 1);
+
+void approximate_degree_pair_priors(const int *source_degrees, int num_source_values,
+                                    const int *target_degrees, int num_target_values,
+                                    double num_edges, double *output);
+
+void scatter_degree_pair_values(const double *table, int num_target_values,
+                                const int *source_index, const int *target_index,
+                                int num_cols, int row_start, int row_end,
+                                double *output);
+
+void scatter_degree_pair_values(const double *table, int num_target_values,
+                                const int *source_index, const int *target_index,
+                                int num_cols, int row_start, int row_end,
+                                float *output);
+
+void edges_to_compressed(const int *edges, size_t num_edges, int num_rows,
+                         int num_cols, bool add_reverse_edges, bool by_column,
+                         std::vector<long long> &indptr, std::vector<int> &indices,
+                         std::vector<int> &data);
+
+void edges_to_packed_matrix(const int *edges, size_t num_edges, int num_rows,
+                            int num_cols, bool add_reverse_edges,
+                            unsigned char *output);
+
+size_t generate_power_law_edges(int num_sources, int num_targets, size_t num_edges,
+                                double exponent, bool bipartite, bool directed,
+                                unsigned long long seed, int num_threads,
+                                std::vector<int> &edges);
+
+// Set of strings stored contiguously in one arena, each with a consecutive id
+class StringInterner
+{
+    public:
+        StringInterner();
+        int intern(const char *value, size_t length);
+        int size() const { return (int)hashes.size(); }
+        const char* string_data(int id) const { return arena.data() + offsets[id]; }
+        size_t string_length(int id) const { return offsets[id + 1] - offsets[id]; }
+        bool less(int a, int b) const;
+        std::vector<int> sorted_ids(int num_threads) const;
+
+    private:
+        std::vector<char> arena;
+        std::vector<size_t> offsets;
+        std::vector<unsigned long long> hashes;
+        std::vector<unsigned long long> slots;
+};
+
+std::vector<int> assign_sorted_ids(const StringInterner &interner, int *node_ids,
+                                   size_t num_ids, size_t stride, int num_threads);
+
+// Binary edge file: this header, then `num_edges` packed int32 (source, target)
+// pairs in native byte order. Node ranges are `[0, max_*_id]`, or empty for -1.
+#define EDGE_FILE_MAGIC "XSWAPEDG"
+#define EDGE_FILE_VERSION 1
+#define EDGE_FILE_DIRECTED 0x1
+#define EDGE_FILE_BIPARTITE 0x2
+
+struct EdgeFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_edges;
+    int32_t max_source_id;
+    int32_t max_target_id;
+    uint64_t checksum;  // FNV-1a of the edges as 32-bit words
+    char reserved[24];
+};
+
+EdgeFileHeader make_edge_file_header(const int *edges, size_t num_edges,
+                                     unsigned int flags);
+
+void write_edge_file(const char *path, const EdgeFileHeader &header, const int *edges);
+
+void permute_edge_file(const char *input_path, const char *output_path,
+                       int num_swaps, Conditions cond, statsCounter *stats,
+                       unsigned long long int max_malloc,
+                       std::vector<int> *permuted_edges);
+
+// Ensemble file: this header, the original packed edges, then one block per
+// permutation of `uint64 num_bytes, uint64 checksum` and the encoded targets
+#define ENSEMBLE_MAGIC "XSWAPENS"
+#define ENSEMBLE_VERSION 1
+
+struct EnsembleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_edges;
+    uint64_t num_permutations;
+    int32_t max_source_id;
+    int32_t max_target_id;
+    char reserved[24];
+};
+
+void encode_permutation(const int *original_edges, const int *permuted_edges,
+                        size_t num_edges, std::vector<unsigned char> &output);
+
+void decode_permutation(const int *original_edges, const unsigned char *data,
+                        size_t num_bytes, size_t num_edges, int *permuted_edges);
+
+// Appends permutations to a new ensemble file (when given `edges`) or an
+// existing one (when `edges` is NULL)
+class EnsembleWriter
+{
+    public:
+        EnsembleWriter(const char *path, const int *edges = NULL, size_t num_edges = 0);
+        void add_permutation(const int *permuted_edges);
+        EnsembleHeader header;
+
+    private:
+        std::fstream file;
+        std::streamoff next_block;  // offset after the last counted block
+        std::vector<int> original_edges;
+        std::vector<unsigned char> encoded;
+};
+
+class MappedFile;
+
+// Random access to the permutations of a memory-mapped ensemble file
+class EnsembleReader
+{
+    public:
+        EnsembleReader(const char *path);
+        ~EnsembleReader();
+        const int* original_edges() const;
+        void permutation(size_t index, int *permuted_edges) const;
+        EnsembleHeader header;
+
+    private:
+        std::unique_ptr<MappedFile> file;
+        std::vector<size_t> block_offsets;
+};
+
+// Receives each permuted network from `write_permutations` as packed edges.
+// `write` may be called from background threads, so it must not use Python.
+// Sinks that are not `ordered` may be written concurrently for different
+// permutations; ordered sinks receive permutations one at a time in order.
+class PermutationSink
+{
+    public:
+        virtual ~PermutationSink() {}
+        virtual void write(int index, const int *edges, size_t num_edges) = 0;
+        virtual bool ordered() const { return false; }
+};
+
+// Delimited text file per permutation, at `path_pattern` with "{}" replaced by
+// the permutation index
+class TextPermutationSink : public PermutationSink
+{
+    public:
+        TextPermutationSink(const char *path_pattern, char node_delim, char edge_delim);
+        void write(int index, const int *edges, size_t num_edges);
+
+    private:
+        std::string path_pattern;
+        char node_delim;
+        char edge_delim;
+};
+
+// Binary edge file per permutation
+class BinaryPermutationSink : public PermutationSink
+{
+    public:
+        BinaryPermutationSink(const char *path_pattern, const int *edges,
+                              size_t num_edges, unsigned int flags);
+        void write(int index, const int *edges, size_t num_edges);
+
+    private:
+        std::string path_pattern;
+        EdgeFileHeader header;
+};
+
+// All permutations in one new ensemble file
+class EnsemblePermutationSink : public PermutationSink
+{
+    public:
+        EnsemblePermutationSink(const char *path, const int *edges, size_t num_edges);
+        void write(int index, const int *edges, size_t num_edges);
+        bool ordered() const { return true; }
+
+    private:
+        EnsembleWriter writer;
+};
+
+void write_permutations(Edges edges, int num_swaps, int num_permutations,
+                        Conditions cond, unsigned long long int max_malloc,
+                        PermutationSink &sink, bool background,
+                        std::vector<statsCounter> &stats, int num_threads = 1);
+
+bool has_duplicate_edges(const int *edges, size_t num_edges);
+
+size_t load_edge_file(const char *path, char node_delim, char edge_delim,
+                      int num_threads, std::vector<int> &edges, int *max_id);
+
+#endif  // XSWAP_XSWAP_H
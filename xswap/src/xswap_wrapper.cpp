@@ -1,26 +1,128 @@
+#include <Python.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "xswap.h"
 
 #define XSWAP_MODULE
 
+/* Load edges from a list of (source, target) pairs, each a tuple, list or
+ other sequence. Returns edges with `num_edges == -1` and a Python exception
+ set on failure. */
 static Edges py_list_to_edges(PyObject *py_list) {
     int num_edges = (int)PyList_Size(py_list);
-    int** edges_array = (int**)malloc(sizeof(int*) * num_edges);
+    Edges return_object = allocate_edges(num_edges);
 
     for (int i = 0; i < num_edges; i++) {
-        edges_array[i] = (int*)malloc(sizeof(int) * 2);
-        PyObject* py_tuple = PyList_GetItem(py_list, i);
+        PyObject* py_pair = PySequence_Fast(PyList_GetItem(py_list, i),
+                                            "Edges must be pairs of node ids.");
+        if (py_pair == NULL || PySequence_Fast_GET_SIZE(py_pair) != 2) {
+            if (py_pair != NULL) {
+                PyErr_SetString(PyExc_ValueError, "Edges must be pairs of node ids.");
+                Py_DECREF(py_pair);
+            }
+            free_edges(return_object);
+            return_object.num_edges = -1;
+            return return_object;
+        }
         for (int j = 0; j < 2; j++) {
-            PyObject* temp = PyTuple_GetItem(py_tuple, j);
-            int value = (int)PyLong_AsLong(temp);
-            edges_array[i][j] = value;
+            PyObject* temp = PySequence_Fast_GET_ITEM(py_pair, j);
+            return_object.edge_array[i][j] = (int)PyLong_AsLong(temp);
+        }
+        Py_DECREF(py_pair);
+        if (PyErr_Occurred()) {
+            free_edges(return_object);
+            return_object.num_edges = -1;
+            return return_object;
         }
     }
-    Edges return_object;
-    return_object.edge_array = edges_array;
-    return_object.num_edges = num_edges;
     return return_object;
 }
 
+/* Get a C-contiguous buffer with `ndim` dimensions, the last of length 2 if
+ there are several, whose items have the native struct format `type`: 'i' for
+ int32 and 'd' for float64 numpy arrays. Returns -1 and sets a ValueError with
+ `message` if the object has another format or shape. */
+static int get_typed_buffer(PyObject *object, Py_buffer *view, char type, int ndim,
+                            const char *message) {
+    if (PyObject_GetBuffer(object, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        return -1;
+    const int one = 1;
+    const char *format = view->format;
+    if (format != NULL && (*format == '@' || *format == '=' ||
+                           (*format == '<' && *(const char*)&one == 1)))
+        format++;
+    Py_ssize_t itemsize = type == 'd' ? sizeof(double) : sizeof(int);
+    if (format == NULL || format[0] != type || format[1] != '\0' ||
+        view->itemsize != itemsize || view->ndim != ndim ||
+        (ndim > 1 && view->shape[ndim - 1] != 2)) {
+        PyErr_SetString(PyExc_ValueError, message);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+/* Converters for "O&" arguments of `PyArg_ParseTuple`, which also call them
+ with NULL to release the buffer if a later argument fails to parse */
+static int int_array_converter(PyObject *object, void *view) {
+    if (object == NULL) {
+        PyBuffer_Release((Py_buffer*)view);
+        return 1;
+    }
+    if (get_typed_buffer(object, (Py_buffer*)view, 'i', 1,
+                         "Expected a one-dimensional int32 array.") != 0)
+        return 0;
+    return Py_CLEANUP_SUPPORTED;
+}
+
+static int int_pairs_converter(PyObject *object, void *view) {
+    if (object == NULL) {
+        PyBuffer_Release((Py_buffer*)view);
+        return 1;
+    }
+    if (get_typed_buffer(object, (Py_buffer*)view, 'i', 2,
+                         "Expected an int32 array with shape (n, 2).") != 0)
+        return 0;
+    return Py_CLEANUP_SUPPORTED;
+}
+
+static int double_array_converter(PyObject *object, void *view) {
+    if (object == NULL) {
+        PyBuffer_Release((Py_buffer*)view);
+        return 1;
+    }
+    if (get_typed_buffer(object, (Py_buffer*)view, 'd', 1,
+                         "Expected a one-dimensional float64 array.") != 0)
+        return 0;
+    return Py_CLEANUP_SUPPORTED;
+}
+
+/* Load edges from a list of tuples or from an object supporting the buffer
+ protocol, such as a C-contiguous int32 numpy array of shape (num_edges, 2).
+ Returns edges with `num_edges == -1` and a Python exception set on failure. */
+static Edges py_object_to_edges(PyObject *py_edges) {
+    if (PyList_Check(py_edges))
+        return py_list_to_edges(py_edges);
+
+    Edges edges;
+    edges.num_edges = -1;
+    Py_buffer view;
+    if (get_typed_buffer(py_edges, &view, 'i', 2,
+                         "Edge arrays must be int32 with shape (num_edges, 2).") != 0)
+        return edges;
+    edges = allocate_edges((int)(view.len / (2 * sizeof(int))));
+    if (edges.num_edges > 0)
+        memcpy(edges.edge_array[0], view.buf, view.len);
+    PyBuffer_Release(&view);
+    return edges;
+}
+
 static PyObject* edge_to_py_tuple(int *edge) {
     PyObject* edge_tuple = PyTuple_New(2);
     for (int j = 0; j < 2; j++) {
@@ -41,6 +143,13 @@ static PyObject* edges_to_py_list(Edges edges) {
     return py_list;
 }
 
+// Copy a vector into a bytearray, which numpy can wrap using `numpy.frombuffer`
+template <typename T>
+static PyObject* vector_to_py_bytearray(const std::vector<T> &values) {
+    return PyByteArray_FromStringAndSize(
+        (const char*)values.data(), sizeof(T) * values.size());
+}
+
 static PyObject* stats_to_py_dict(statsCounter& stats) {
     PyObject* py_num_swaps = PyLong_FromLong(stats.num_swaps);
     PyObject* py_same_edge = PyLong_FromLong(stats.same_edge);
@@ -59,21 +168,97 @@ static PyObject* stats_to_py_dict(statsCounter& stats) {
     return dict;
 }
 
+static PyObject* count_to_py(long long count) {
+    if (count < 0)
+        Py_RETURN_NONE;
+    return PyLong_FromLongLong(count);
+}
+
+static void set_dict_item(PyObject *dict, const char *key, PyObject *value) {
+    PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+}
+
+// Add the measurements of an instrumented `swap_edges` call to a stats dict
+static void add_profile_to_py_dict(PyObject *dict, const statsCounter &stats,
+                                   const SwapProfile &profile, Edges edges,
+                                   double input_seconds, double output_seconds) {
+    size_t edge_bytes = edges.num_edges * (2 * sizeof(int) + sizeof(int*));
+    set_dict_item(dict, "accepted_swaps", PyLong_FromLong(accepted_swaps(stats)));
+    set_dict_item(dict, "backend",
+                  PyUnicode_FromString(profile.roaring ? "roaring" : "uncompressed"));
+    set_dict_item(dict, "bitset_bytes", PyLong_FromSize_t(profile.bitset_bytes));
+    set_dict_item(dict, "edge_bytes", PyLong_FromSize_t(edge_bytes));
+    set_dict_item(dict, "input_conversion_seconds", PyFloat_FromDouble(input_seconds));
+    set_dict_item(dict, "bitset_seconds", PyFloat_FromDouble(profile.bitset_seconds));
+    set_dict_item(dict, "swap_seconds", PyFloat_FromDouble(profile.swap_seconds));
+    set_dict_item(dict, "output_conversion_seconds", PyFloat_FromDouble(output_seconds));
+    if (profile.hardware_counters) {
+        set_dict_item(dict, "cycles", count_to_py(profile.cycles));
+        set_dict_item(dict, "cache_misses", count_to_py(profile.cache_misses));
+    }
+}
+
+// Permuted edges in the form of the input: a list of tuples for a list, or
+// else a packed int32 buffer
+static PyObject* permuted_edges_to_py(PyObject *py_edges, Edges edges) {
+    if (PyList_Check(py_edges))
+        return edges_to_py_list(edges);
+    const char* packed_edges = edges.num_edges > 0 ? (const char*)edges.edge_array[0] : "";
+    return PyByteArray_FromStringAndSize(packed_edges, 2 * sizeof(int) * edges.num_edges);
+}
+
+/* Run `work` without the GIL, so that other Python threads run during long
+ native calls. `work` may only touch memory owned by the call or pinned by a
+ held buffer. Its warnings are collected and emitted once the GIL is held
+ again, and an exception it throws is rethrown then. */
+template <typename Work>
+static void run_without_gil(Work work) {
+    std::vector<std::string> warnings;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        WarningCapture capture(&warnings);
+        try {
+            work();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    Py_END_ALLOW_THREADS
+    for (size_t i = 0; i < warnings.size(); i++) {
+        emit_warning(warnings[i].c_str());
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
 static PyObject* wrap_xswap(PyObject *self, PyObject *args) {
     // Get arguments from python and compute quantities where needed
     PyObject *py_edges, *py_excluded_edges;
     int max_id, num_swaps, seed, allow_self_loop, allow_antiparallel;
+    int instrument = 0, hardware_counters = 0;
     unsigned long long int max_malloc;
-    int parsed_successfully = PyArg_ParseTuple(args, "OOippiiK", &py_edges,
+    int parsed_successfully = PyArg_ParseTuple(args, "OOippiiK|pp", &py_edges,
         &py_excluded_edges, &max_id, &allow_self_loop,
-        &allow_antiparallel, &num_swaps, &seed, &max_malloc);
+        &allow_antiparallel, &num_swaps, &seed, &max_malloc, &instrument,
+        &hardware_counters);
     if (!parsed_successfully)
         return NULL;
 
-    // Load edges from python list
-    Edges edges = py_list_to_edges(py_edges);
+    // Load edges from a python list or an int32 array
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0)
+        return NULL;
     edges.max_id = max_id;
     Edges excluded_edges = py_list_to_edges(py_excluded_edges);
+    if (excluded_edges.num_edges < 0) {
+        free_edges(edges);
+        return NULL;
+    }
+    double input_seconds = std::chrono::duration<double>(clock::now() - start).count();
 
     // Set the conditions under which new edges are accepted
     Conditions valid_cond;
@@ -86,32 +271,859 @@ static PyObject* wrap_xswap(PyObject *self, PyObject *args) {
     statsCounter stats;
     stats.num_swaps = num_swaps;
 
-    // Perform XSwap
-    swap_edges(edges, num_swaps, valid_cond, &stats, max_malloc);
+    // Perform XSwap, timing its phases if instrumented
+    SwapProfile profile;
+    profile.hardware_counters = hardware_counters;
+    run_without_gil([&]() {
+        swap_edges(edges, num_swaps, valid_cond, &stats, max_malloc,
+                   instrument ? &profile : NULL);
+    });
 
-    // Get new edges as python list
-    PyObject* py_list = edges_to_py_list(edges);
+    // Get new edges as python list, or as a packed int32 buffer for array input
+    start = clock::now();
+    PyObject* py_list = permuted_edges_to_py(py_edges, edges);
+    double output_seconds = std::chrono::duration<double>(clock::now() - start).count();
 
     // Get stats as python dict
     PyObject* stats_py_dict = stats_to_py_dict(stats);
+    if (instrument)
+        add_profile_to_py_dict(stats_py_dict, stats, profile, edges, input_seconds,
+                               output_seconds);
 
     // Create and return a python tuple of new_edges, stats
     PyObject* return_tuple = PyTuple_New(2);
     PyTuple_SET_ITEM(return_tuple, 0, py_list);
     PyTuple_SET_ITEM(return_tuple, 1, stats_py_dict);
-    for (int i = 0; i < edges.num_edges; i++) {
-        free(edges.edge_array[i]);
+    free_edges(edges);
+    free_edges(valid_cond.excluded_edges);
+    return return_tuple;
+}
+
+/* Permute several networks on a shared pool of threads. Each network is a tuple
+ of the arguments of `_xswap` other than `max_malloc`. Returns a list of
+ `(new_edges, stats)` tuples in the order of the networks. */
+static PyObject* wrap_xswap_networks(PyObject *self, PyObject *args) {
+    PyObject *py_networks;
+    unsigned long long int max_malloc;
+    int num_threads;
+    if (!PyArg_ParseTuple(args, "O!Ki", &PyList_Type, &py_networks, &max_malloc, &num_threads))
+        return NULL;
+
+    Py_ssize_t num_networks = PyList_Size(py_networks);
+    std::vector<PyObject*> py_edges(num_networks);
+    std::vector<Edges> networks;
+    std::vector<int> num_swaps(num_networks);
+    std::vector<Conditions> conds(num_networks);
+    bool parsed_successfully = true;
+    for (Py_ssize_t i = 0; i < num_networks && parsed_successfully; i++) {
+        PyObject* py_excluded_edges;
+        int max_id, allow_self_loop, allow_antiparallel;
+        parsed_successfully = PyArg_ParseTuple(PyList_GetItem(py_networks, i), "OO!ippii",
+            &py_edges[i], &PyList_Type, &py_excluded_edges, &max_id, &allow_self_loop,
+            &allow_antiparallel, &num_swaps[i], &conds[i].seed);
+        if (!parsed_successfully)
+            break;
+        Edges edges = py_object_to_edges(py_edges[i]);
+        if (edges.num_edges < 0) {
+            parsed_successfully = false;
+            break;
+        }
+        edges.max_id = max_id;
+        conds[i].allow_self_loop = allow_self_loop;
+        conds[i].allow_antiparallel = allow_antiparallel;
+        conds[i].excluded_edges = py_list_to_edges(py_excluded_edges);
+        if (conds[i].excluded_edges.num_edges < 0) {
+            free_edges(edges);
+            parsed_successfully = false;
+            break;
+        }
+        networks.push_back(edges);
+    }
+
+    PyObject* result = NULL;
+    if (parsed_successfully) {
+        try {
+            std::vector<statsCounter> stats;
+            run_without_gil([&]() {
+                permute_networks(networks, num_swaps, conds, max_malloc, num_threads, stats);
+            });
+            result = PyList_New(num_networks);
+            for (Py_ssize_t i = 0; i < num_networks && result != NULL; i++) {
+                PyObject* py_tuple = PyTuple_New(2);
+                PyTuple_SET_ITEM(py_tuple, 0, permuted_edges_to_py(py_edges[i], networks[i]));
+                PyTuple_SET_ITEM(py_tuple, 1, stats_to_py_dict(stats[i]));
+                PyList_SET_ITEM(result, i, py_tuple);
+            }
+        } catch (const std::exception &e) {
+            PyErr_SetString(PyExc_ValueError, e.what());
+        }
     }
-    free(edges.edge_array);
-    for (int i = 0; i < valid_cond.excluded_edges.num_edges; i++) {
-        free(valid_cond.excluded_edges.edge_array[i]);
+    for (size_t i = 0; i < networks.size(); i++) {
+        free_edges(networks[i]);
+        free_edges(conds[i].excluded_edges);
     }
-    free(valid_cond.excluded_edges.edge_array);
-    return return_tuple;
+    return result;
+}
+
+static PyObject* wrap_xswap_occurrence(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    int max_id, num_swaps, initial_seed, num_permutations, num_rows, num_cols;
+    int allow_self_loop, allow_antiparallel, sparse, num_threads;
+    unsigned long long int max_malloc;
+    int parsed_successfully = PyArg_ParseTuple(args, "OippiiiKiipi", &py_edges,
+        &max_id, &allow_self_loop, &allow_antiparallel, &num_swaps,
+        &initial_seed, &num_permutations, &max_malloc, &num_rows, &num_cols,
+        &sparse, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0)
+        return NULL;
+    edges.max_id = max_id;
+
+    Conditions valid_cond;
+    valid_cond.seed = initial_seed;
+    valid_cond.allow_self_loop = allow_self_loop;
+    valid_cond.allow_antiparallel = allow_antiparallel;
+    valid_cond.excluded_edges = allocate_edges(0);
+
+    // Dense counts are written directly into the returned buffer
+    PyObject* py_dense_counts = NULL;
+    long long* dense_counts = NULL;
+    if (!sparse) {
+        size_t num_bytes = sizeof(long long) * (size_t)num_rows * num_cols;
+        py_dense_counts = PyByteArray_FromStringAndSize(NULL, num_bytes);
+        if (py_dense_counts == NULL) {
+            free_edges(edges);
+            free_edges(valid_cond.excluded_edges);
+            return NULL;
+        }
+        dense_counts = (long long*)PyByteArray_AS_STRING(py_dense_counts);
+        memset(dense_counts, 0, num_bytes);
+    }
+
+    PyObject* result = NULL;
+    try {
+        OccurrenceCounter counter = OccurrenceCounter(num_rows, num_cols,
+            !allow_antiparallel, dense_counts, max_malloc);
+        run_without_gil([&]() {
+            count_edge_occurrences(edges, num_swaps, num_permutations, valid_cond,
+                                   max_malloc, counter, num_threads);
+        });
+        if (sparse) {
+            size_t num_nonzero = counter.num_nonzero();
+            PyObject* py_rows = PyByteArray_FromStringAndSize(NULL, sizeof(int) * num_nonzero);
+            PyObject* py_cols = PyByteArray_FromStringAndSize(NULL, sizeof(int) * num_nonzero);
+            PyObject* py_counts = PyByteArray_FromStringAndSize(NULL, sizeof(long long) * num_nonzero);
+            counter.to_coo((int*)PyByteArray_AS_STRING(py_rows),
+                           (int*)PyByteArray_AS_STRING(py_cols),
+                           (long long*)PyByteArray_AS_STRING(py_counts));
+            result = PyTuple_Pack(3, py_rows, py_cols, py_counts);
+            Py_DECREF(py_rows);
+            Py_DECREF(py_cols);
+            Py_DECREF(py_counts);
+        } else {
+            result = py_dense_counts;
+        }
+    } catch (const std::exception &e) {
+        Py_XDECREF(py_dense_counts);
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    free_edges(edges);
+    free_edges(valid_cond.excluded_edges);
+    return result;
+}
+
+static PyObject* wrap_xswap_degree_counts(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    Py_buffer source_degrees, target_degrees;
+    int max_id, num_swaps, initial_seed, num_permutations, num_threads;
+    int allow_self_loop, allow_antiparallel;
+    unsigned long long int max_malloc;
+    int parsed_successfully = PyArg_ParseTuple(args, "OippiiiKO&O&i", &py_edges,
+        &max_id, &allow_self_loop, &allow_antiparallel, &num_swaps,
+        &initial_seed, &num_permutations, &max_malloc, int_array_converter,
+        &source_degrees, int_array_converter, &target_degrees, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0) {
+        PyBuffer_Release(&source_degrees);
+        PyBuffer_Release(&target_degrees);
+        return NULL;
+    }
+    edges.max_id = max_id;
+
+    Conditions valid_cond;
+    valid_cond.seed = initial_seed;
+    valid_cond.allow_self_loop = allow_self_loop;
+    valid_cond.allow_antiparallel = allow_antiparallel;
+    valid_cond.excluded_edges = allocate_edges(0);
+
+    PyObject* result = NULL;
+    try {
+        // Degree arrays are int32 numpy arrays, one entry per source/target node
+        DegreePairCounter counter = DegreePairCounter(
+            (int*)source_degrees.buf, (int)(source_degrees.len / sizeof(int)),
+            (int*)target_degrees.buf, (int)(target_degrees.len / sizeof(int)),
+            !allow_antiparallel);
+        run_without_gil([&]() {
+            count_edge_occurrences(edges, num_swaps, num_permutations, valid_cond,
+                                   max_malloc, counter, num_threads);
+        });
+        result = Py_BuildValue("(NNNNNN)",
+            vector_to_py_bytearray(counter.source_degree_values),
+            vector_to_py_bytearray(counter.target_degree_values),
+            vector_to_py_bytearray(counter.source_degree_nodes),
+            vector_to_py_bytearray(counter.target_degree_nodes),
+            vector_to_py_bytearray(counter.counts),
+            vector_to_py_bytearray(counter.squared_counts));
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    PyBuffer_Release(&source_degrees);
+    PyBuffer_Release(&target_degrees);
+    free_edges(edges);
+    free_edges(valid_cond.excluded_edges);
+    return result;
+}
+
+static PyObject* wrap_xswap_query_counts(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    Py_buffer source_degrees, target_degrees, queries;
+    int max_id, num_swaps, initial_seed, num_permutations, num_threads;
+    int allow_self_loop, allow_antiparallel;
+    unsigned long long int max_malloc;
+    int parsed_successfully = PyArg_ParseTuple(args, "OippiiiKO&O&O&i", &py_edges,
+        &max_id, &allow_self_loop, &allow_antiparallel, &num_swaps,
+        &initial_seed, &num_permutations, &max_malloc, int_array_converter,
+        &source_degrees, int_array_converter, &target_degrees, int_pairs_converter,
+        &queries, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0) {
+        PyBuffer_Release(&source_degrees);
+        PyBuffer_Release(&target_degrees);
+        PyBuffer_Release(&queries);
+        return NULL;
+    }
+    edges.max_id = max_id;
+
+    Conditions valid_cond;
+    valid_cond.seed = initial_seed;
+    valid_cond.allow_self_loop = allow_self_loop;
+    valid_cond.allow_antiparallel = allow_antiparallel;
+    valid_cond.excluded_edges = allocate_edges(0);
+
+    PyObject* result = NULL;
+    try {
+        // Queries are an int32 numpy array of shape (num_queries, 2)
+        int num_queries = (int)(queries.len / (2 * sizeof(int)));
+        QueryCounter counter = QueryCounter(
+            (int*)source_degrees.buf, (int)(source_degrees.len / sizeof(int)),
+            (int*)target_degrees.buf, (int)(target_degrees.len / sizeof(int)),
+            !allow_antiparallel, (int*)queries.buf, num_queries);
+        run_without_gil([&]() {
+            count_edge_occurrences(edges, num_swaps, num_permutations, valid_cond,
+                                   max_malloc, counter, num_threads);
+        });
+        std::vector<long long> query_counts(num_queries);
+        counter.query_counts(query_counts.data());
+        result = Py_BuildValue("(NNNNNN)",
+            vector_to_py_bytearray(counter.source_degree_values),
+            vector_to_py_bytearray(counter.target_degree_values),
+            vector_to_py_bytearray(counter.source_degree_nodes),
+            vector_to_py_bytearray(counter.target_degree_nodes),
+            vector_to_py_bytearray(counter.counts),
+            vector_to_py_bytearray(query_counts));
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    PyBuffer_Release(&source_degrees);
+    PyBuffer_Release(&target_degrees);
+    PyBuffer_Release(&queries);
+    free_edges(edges);
+    free_edges(valid_cond.excluded_edges);
+    return result;
+}
+
+static PyObject* wrap_approximate_degree_pairs(PyObject *self, PyObject *args) {
+    Py_buffer source_degrees, target_degrees;
+    double num_edges;
+    int parsed_successfully = PyArg_ParseTuple(args, "O&O&d", int_array_converter,
+        &source_degrees, int_array_converter, &target_degrees, &num_edges);
+    if (!parsed_successfully)
+        return NULL;
+
+    int num_source_values = (int)(source_degrees.len / sizeof(int));
+    int num_target_values = (int)(target_degrees.len / sizeof(int));
+    PyObject* py_values = PyByteArray_FromStringAndSize(
+        NULL, sizeof(double) * (size_t)num_source_values * num_target_values);
+    if (py_values != NULL) {
+        approximate_degree_pair_priors(
+            (int*)source_degrees.buf, num_source_values, (int*)target_degrees.buf,
+            num_target_values, num_edges, (double*)PyByteArray_AS_STRING(py_values));
+    }
+    PyBuffer_Release(&source_degrees);
+    PyBuffer_Release(&target_degrees);
+    return py_values;
+}
+
+static PyObject* wrap_scatter_degree_pairs(PyObject *self, PyObject *args) {
+    Py_buffer table, source_index, target_index;
+    int num_target_values, row_start, row_end;
+    int single_precision = 0;
+    int parsed_successfully = PyArg_ParseTuple(args, "O&iO&O&ii|p",
+        double_array_converter, &table, &num_target_values, int_array_converter,
+        &source_index, int_array_converter, &target_index, &row_start, &row_end,
+        &single_precision);
+    if (!parsed_successfully)
+        return NULL;
+
+    int num_rows = (int)(source_index.len / sizeof(int));
+    int num_cols = (int)(target_index.len / sizeof(int));
+    size_t value_size = single_precision ? sizeof(float) : sizeof(double);
+    PyObject* py_values = NULL;
+    if (row_start < 0 || row_end > num_rows || row_start > row_end) {
+        PyErr_SetString(PyExc_IndexError, "Row range is outside the source nodes.");
+    } else {
+        py_values = PyByteArray_FromStringAndSize(
+            NULL, value_size * (size_t)(row_end - row_start) * num_cols);
+    }
+    if (py_values != NULL) {
+        char* output = PyByteArray_AS_STRING(py_values);
+        if (single_precision) {
+            scatter_degree_pair_values((double*)table.buf, num_target_values,
+                                       (int*)source_index.buf, (int*)target_index.buf,
+                                       num_cols, row_start, row_end, (float*)output);
+        } else {
+            scatter_degree_pair_values((double*)table.buf, num_target_values,
+                                       (int*)source_index.buf, (int*)target_index.buf,
+                                       num_cols, row_start, row_end, (double*)output);
+        }
+    }
+    PyBuffer_Release(&table);
+    PyBuffer_Release(&source_index);
+    PyBuffer_Release(&target_index);
+    return py_values;
+}
+
+static PyObject* wrap_edges_to_compressed(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    int num_rows, num_cols, add_reverse_edges, by_column;
+    int parsed_successfully = PyArg_ParseTuple(args, "Oiipp", &py_edges, &num_rows,
+        &num_cols, &add_reverse_edges, &by_column);
+    if (!parsed_successfully)
+        return NULL;
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        // Edges from `allocate_edges` are packed, starting at `edge_array[0]`
+        std::vector<long long> indptr;
+        std::vector<int> indices, data;
+        const int* packed_edges = edges.num_edges > 0 ? edges.edge_array[0] : NULL;
+        edges_to_compressed(packed_edges, edges.num_edges, num_rows, num_cols,
+                            add_reverse_edges, by_column, indptr, indices, data);
+        result = Py_BuildValue("(NNN)", vector_to_py_bytearray(indptr),
+                               vector_to_py_bytearray(indices),
+                               vector_to_py_bytearray(data));
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    free_edges(edges);
+    return result;
+}
+
+static PyObject* wrap_edges_to_packed(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    int num_rows, num_cols, add_reverse_edges;
+    int parsed_successfully = PyArg_ParseTuple(args, "Oiip", &py_edges, &num_rows,
+        &num_cols, &add_reverse_edges);
+    if (!parsed_successfully)
+        return NULL;
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0)
+        return NULL;
+
+    size_t row_bytes = ((size_t)num_cols + CHAR_BITS - 1) / CHAR_BITS;
+    PyObject* py_matrix = PyByteArray_FromStringAndSize(NULL, row_bytes * num_rows);
+    if (py_matrix != NULL) {
+        try {
+            const int* packed_edges = edges.num_edges > 0 ? edges.edge_array[0] : NULL;
+            edges_to_packed_matrix(packed_edges, edges.num_edges, num_rows, num_cols,
+                add_reverse_edges, (unsigned char*)PyByteArray_AS_STRING(py_matrix));
+        } catch (const std::exception &e) {
+            PyErr_SetString(PyExc_ValueError, e.what());
+            Py_CLEAR(py_matrix);
+        }
+    }
+    free_edges(edges);
+    return py_matrix;
+}
+
+static PyObject* wrap_generate_power_law_edges(PyObject *self, PyObject *args) {
+    int num_sources, num_targets, bipartite, directed, num_threads;
+    unsigned long long int num_edges, seed;
+    double exponent;
+    int parsed_successfully = PyArg_ParseTuple(args, "iiKdppKi", &num_sources,
+        &num_targets, &num_edges, &exponent, &bipartite, &directed, &seed, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        std::vector<int> edges;
+        generate_power_law_edges(num_sources, num_targets, num_edges, exponent, bipartite,
+                                 directed, seed, num_threads, edges);
+        result = vector_to_py_bytearray(edges);
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    return result;
+}
+
+static PyObject* wrap_load_edge_file(PyObject *self, PyObject *args) {
+    const char *path;
+    int node_delim, edge_delim, num_threads;
+    int parsed_successfully = PyArg_ParseTuple(args, "sCCi", &path, &node_delim,
+        &edge_delim, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+    if (node_delim > 127 || edge_delim > 127 || node_delim == edge_delim) {
+        PyErr_SetString(PyExc_ValueError,
+            "Delimiters must be distinct single ASCII characters.");
+        return NULL;
+    }
+
+    PyObject* result = NULL;
+    try {
+        std::vector<int> edges;
+        int max_id;
+        load_edge_file(path, (char)node_delim, (char)edge_delim, num_threads, edges, &max_id);
+        result = vector_to_py_bytearray(edges);
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    return result;
+}
+
+static PyObject* wrap_write_edge_file(PyObject *self, PyObject *args) {
+    const char *path;
+    Py_buffer edges;
+    unsigned int flags;
+    int parsed_successfully = PyArg_ParseTuple(args, "sO&I", &path, int_pairs_converter,
+        &edges, &flags);
+    if (!parsed_successfully)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        // Edges are an int32 numpy array of shape (num_edges, 2)
+        size_t num_edges = edges.len / (2 * sizeof(int));
+        EdgeFileHeader header = make_edge_file_header((int*)edges.buf, num_edges, flags);
+        write_edge_file(path, header, (int*)edges.buf);
+        result = Py_None;
+        Py_INCREF(result);
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    PyBuffer_Release(&edges);
+    return result;
+}
+
+static PyObject* wrap_xswap_file(PyObject *self, PyObject *args) {
+    const char *input_path, *output_path;
+    PyObject *py_excluded_edges;
+    int num_swaps, seed, allow_self_loop, allow_antiparallel;
+    unsigned long long int max_malloc;
+    int parsed_successfully = PyArg_ParseTuple(args, "szOppiiK", &input_path,
+        &output_path, &py_excluded_edges, &allow_self_loop, &allow_antiparallel,
+        &num_swaps, &seed, &max_malloc);
+    if (!parsed_successfully)
+        return NULL;
+
+    Conditions valid_cond;
+    valid_cond.seed = seed;
+    valid_cond.allow_self_loop = allow_self_loop;
+    valid_cond.allow_antiparallel = allow_antiparallel;
+    valid_cond.excluded_edges = py_list_to_edges(py_excluded_edges);
+    if (valid_cond.excluded_edges.num_edges < 0)
+        return NULL;
+
+    statsCounter stats;
+    stats.num_swaps = num_swaps;
+
+    PyObject* result = NULL;
+    try {
+        std::vector<int> permuted_edges;
+        run_without_gil([&]() {
+            permute_edge_file(input_path, output_path, num_swaps, valid_cond, &stats,
+                              max_malloc, &permuted_edges);
+        });
+        PyObject* py_edges = Py_None;
+        if (output_path == NULL) {
+            py_edges = vector_to_py_bytearray(permuted_edges);
+        } else {
+            Py_INCREF(py_edges);
+        }
+        result = Py_BuildValue("(NN)", py_edges, stats_to_py_dict(stats));
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    free_edges(valid_cond.excluded_edges);
+    return result;
+}
+
+static PyObject* wrap_create_ensemble(PyObject *self, PyObject *args) {
+    const char *path;
+    Py_buffer edges;
+    int parsed_successfully = PyArg_ParseTuple(args, "sO&", &path, int_pairs_converter,
+        &edges);
+    if (!parsed_successfully)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        EnsembleWriter writer(path, (int*)edges.buf, edges.len / (2 * sizeof(int)));
+        result = Py_None;
+        Py_INCREF(result);
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    PyBuffer_Release(&edges);
+    return result;
+}
+
+static PyObject* wrap_append_ensemble(PyObject *self, PyObject *args) {
+    const char *path;
+    PyObject *py_permutations;
+    Py_buffer permutations;
+    int parsed_successfully = PyArg_ParseTuple(args, "sO", &path, &py_permutations);
+    if (!parsed_successfully)
+        return NULL;
+    if (get_typed_buffer(py_permutations, &permutations, 'i', 3,
+            "Permutations must be int32 with shape (num_permutations, num_edges, 2).") != 0)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        // Permutations are an int32 array of shape (num_permutations, num_edges, 2)
+        EnsembleWriter writer(path);
+        size_t permutation_size = 2 * writer.header.num_edges;
+        size_t num_values = permutations.len / sizeof(int);
+        if (permutation_size == 0 ? num_values != 0 : num_values % permutation_size != 0)
+            throw std::invalid_argument("Permutations must have the same number of edges as the ensemble.");
+        for (size_t offset = 0; offset < num_values; offset += permutation_size) {
+            writer.add_permutation((int*)permutations.buf + offset);
+        }
+        result = PyLong_FromUnsignedLongLong(writer.header.num_permutations);
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    PyBuffer_Release(&permutations);
+    return result;
+}
+
+static const char ENSEMBLE_CAPSULE[] = "xswap.EnsembleReader";
+
+static void free_ensemble_capsule(PyObject *capsule) {
+    delete (EnsembleReader*)PyCapsule_GetPointer(capsule, ENSEMBLE_CAPSULE);
+}
+
+/* Map an ensemble file and index its blocks. Returns a capsule owning the
+ reader, for `_read_ensemble`, and the header fields `(num_edges,
+ num_permutations, max_source_id, max_target_id)`. */
+static PyObject* wrap_open_ensemble(PyObject *self, PyObject *args) {
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+
+    EnsembleReader* reader = NULL;
+    try {
+        reader = new EnsembleReader(path);
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return NULL;
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+        return NULL;
+    }
+    PyObject* capsule = PyCapsule_New(reader, ENSEMBLE_CAPSULE, free_ensemble_capsule);
+    if (capsule == NULL) {
+        delete reader;
+        return NULL;
+    }
+    return Py_BuildValue("(NKKii)", capsule, reader->header.num_edges,
+                         reader->header.num_permutations, reader->header.max_source_id,
+                         reader->header.max_target_id);
+}
+
+static PyObject* wrap_read_ensemble(PyObject *self, PyObject *args) {
+    PyObject *capsule;
+    long long index;
+    int parsed_successfully = PyArg_ParseTuple(args, "OL", &capsule, &index);
+    if (!parsed_successfully)
+        return NULL;
+    EnsembleReader* reader = (EnsembleReader*)PyCapsule_GetPointer(capsule, ENSEMBLE_CAPSULE);
+    if (reader == NULL)
+        return NULL;
+
+    PyObject* result = NULL;
+    try {
+        // Index -1 gives the original edges
+        std::vector<int> edges(2 * reader->header.num_edges);
+        if (index < 0)
+            std::copy(reader->original_edges(), reader->original_edges() + edges.size(),
+                      edges.begin());
+        else
+            reader->permutation((size_t)index, edges.data());
+        result = vector_to_py_bytearray(edges);
+    } catch (const std::out_of_range &e) {
+        PyErr_SetString(PyExc_IndexError, e.what());
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    return result;
+}
+
+static PyObject* wrap_xswap_write(PyObject *self, PyObject *args) {
+    PyObject *py_edges, *py_excluded_edges;
+    const char *path, *output_format;
+    int max_id, num_swaps, initial_seed, num_permutations, node_delim, edge_delim;
+    int allow_self_loop, allow_antiparallel, background, num_threads;
+    unsigned long long int max_malloc;
+    int parsed_successfully = PyArg_ParseTuple(args, "OOippiiiKssCCpi", &py_edges,
+        &py_excluded_edges, &max_id, &allow_self_loop, &allow_antiparallel,
+        &num_swaps, &initial_seed, &num_permutations, &max_malloc, &path,
+        &output_format, &node_delim, &edge_delim, &background, &num_threads);
+    if (!parsed_successfully)
+        return NULL;
+    if (node_delim > 127 || edge_delim > 127) {
+        PyErr_SetString(PyExc_ValueError, "Delimiters must be single ASCII characters.");
+        return NULL;
+    }
+
+    Edges edges = py_object_to_edges(py_edges);
+    if (edges.num_edges < 0)
+        return NULL;
+    edges.max_id = max_id;
+
+    Conditions valid_cond;
+    valid_cond.seed = initial_seed;
+    valid_cond.allow_self_loop = allow_self_loop;
+    valid_cond.allow_antiparallel = allow_antiparallel;
+    valid_cond.excluded_edges = py_list_to_edges(py_excluded_edges);
+    if (valid_cond.excluded_edges.num_edges < 0) {
+        free_edges(edges);
+        return NULL;
+    }
+
+    PyObject* result = NULL;
+    try {
+        const int* packed_edges = edges.num_edges > 0 ? edges.edge_array[0] : NULL;
+        std::unique_ptr<PermutationSink> sink;
+        if (strcmp(output_format, "text") == 0)
+            sink.reset(new TextPermutationSink(path, (char)node_delim, (char)edge_delim));
+        else if (strcmp(output_format, "binary") == 0)
+            sink.reset(new BinaryPermutationSink(path, packed_edges, edges.num_edges, 0));
+        else if (strcmp(output_format, "ensemble") == 0)
+            sink.reset(new EnsemblePermutationSink(path, packed_edges, edges.num_edges));
+        else
+            throw std::invalid_argument("Output format must be 'text', 'binary' or 'ensemble'.");
+
+        std::vector<statsCounter> stats;
+        run_without_gil([&]() {
+            write_permutations(edges, num_swaps, num_permutations, valid_cond, max_malloc,
+                               *sink, background, stats, num_threads);
+        });
+        result = PyList_New(stats.size());
+        for (size_t i = 0; i < stats.size() && result != NULL; i++) {
+            PyList_SET_ITEM(result, i, stats_to_py_dict(stats[i]));
+        }
+    } catch (const std::logic_error &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    }
+    free_edges(edges);
+    free_edges(valid_cond.excluded_edges);
+    return result;
+}
+
+// Sorted list of the original name objects, given as one reference per interned id
+static PyObject* sorted_names_to_py_list(const std::vector<int> &sorted_ids,
+                                         const std::vector<PyObject*> &names) {
+    PyObject* py_list = PyList_New(sorted_ids.size());
+    if (py_list == NULL)
+        return NULL;
+    for (size_t i = 0; i < sorted_ids.size(); i++) {
+        PyObject* name = names[sorted_ids[i]];
+        Py_INCREF(name);
+        PyList_SET_ITEM(py_list, i, name);
+    }
+    return py_list;
+}
+
+/* List of edge tuples from packed ids. Each id's int object is created once
+ and shared between edges, as when ids come from a dict. */
+static PyObject* packed_ids_to_py_list(const std::vector<int> &edges, size_t num_ids) {
+    std::vector<PyObject*> py_ids(num_ids, (PyObject*)NULL);
+    PyObject* py_list = PyList_New(edges.size() / 2);
+    for (size_t i = 0; i < num_ids && py_list != NULL; i++) {
+        py_ids[i] = PyLong_FromSize_t(i);
+        if (py_ids[i] == NULL)
+            Py_CLEAR(py_list);
+    }
+    for (size_t i = 0; i < edges.size() / 2 && py_list != NULL; i++) {
+        PyObject* edge_tuple = PyTuple_Pack(2, py_ids[edges[2 * i]], py_ids[edges[2 * i + 1]]);
+        if (edge_tuple == NULL)
+            Py_CLEAR(py_list);
+        else
+            PyList_SET_ITEM(py_list, i, edge_tuple);
+    }
+    for (size_t i = 0; i < num_ids; i++) {
+        Py_XDECREF(py_ids[i]);
+    }
+    return py_list;
+}
+
+static PyObject* wrap_map_str_edges(PyObject *self, PyObject *args) {
+    PyObject *py_edges;
+    int bipartite, num_threads, as_list;
+    int parsed_successfully = PyArg_ParseTuple(args, "Opip", &py_edges, &bipartite,
+        &num_threads, &as_list);
+    if (!parsed_successfully)
+        return NULL;
+    PyObject* py_sequence = PySequence_Fast(py_edges, "Edges must be a sequence.");
+    if (py_sequence == NULL)
+        return NULL;
+    Py_ssize_t num_edges = PySequence_Fast_GET_SIZE(py_sequence);
+
+    // Intern names, keeping the first object seen for each to build the mapping
+    StringInterner source_interner, target_interner;
+    StringInterner* interners[2] = {&source_interner, bipartite ? &target_interner : &source_interner};
+    std::vector<PyObject*> source_names, target_names;
+    std::vector<PyObject*>* names[2] = {&source_names, bipartite ? &target_names : &source_names};
+    std::vector<int> edges(2 * num_edges);
+    bool failed = false;
+    for (Py_ssize_t i = 0; i < num_edges && !failed; i++) {
+        PyObject* py_edge = PySequence_Fast_GET_ITEM(py_sequence, i);
+        for (int j = 0; j < 2 && !failed; j++) {
+            PyObject* name = PySequence_GetItem(py_edge, j);
+            if (name == NULL || !PyUnicode_Check(name)) {
+                if (name != NULL)
+                    PyErr_SetString(PyExc_TypeError, "Node names must be str.");
+                Py_XDECREF(name);
+                failed = true;
+                break;
+            }
+            Py_ssize_t length;
+            const char* value = PyUnicode_AsUTF8AndSize(name, &length);
+            if (value == NULL) {
+                Py_DECREF(name);
+                failed = true;
+                break;
+            }
+            int id = interners[j]->intern(value, length);
+            edges[2 * i + j] = id;
+            if (id == (int)names[j]->size())
+                names[j]->push_back(name);
+            else
+                Py_DECREF(name);
+        }
+    }
+    Py_DECREF(py_sequence);
+
+    PyObject* result = NULL;
+    if (!failed) {
+        std::vector<int> source_sorted, target_sorted;
+        if (bipartite) {
+            source_sorted = assign_sorted_ids(source_interner, edges.data(), num_edges, 2, num_threads);
+            target_sorted = assign_sorted_ids(target_interner, edges.data() + 1, num_edges, 2, num_threads);
+        } else {
+            source_sorted = assign_sorted_ids(source_interner, edges.data(), 2 * num_edges, 1, num_threads);
+        }
+        PyObject* py_source_names = sorted_names_to_py_list(source_sorted, source_names);
+        PyObject* py_target_names = NULL;
+        if (!bipartite) {
+            py_target_names = py_source_names;
+            Py_XINCREF(py_target_names);
+        } else {
+            py_target_names = sorted_names_to_py_list(target_sorted, target_names);
+        }
+        if (py_source_names != NULL && py_target_names != NULL)
+            result = Py_BuildValue("(NOO)", as_list
+                ? packed_ids_to_py_list(edges, std::max(source_sorted.size(), target_sorted.size()))
+                : vector_to_py_bytearray(edges), py_source_names, py_target_names);
+        Py_XDECREF(py_source_names);
+        Py_XDECREF(py_target_names);
+    }
+    for (size_t i = 0; i < source_names.size(); i++) {
+        Py_DECREF(source_names[i]);
+    }
+    for (size_t i = 0; i < target_names.size(); i++) {
+        Py_DECREF(target_names[i]);
+    }
+    return result;
 }
 
 static PyMethodDef XSwapMethods[] = {
     {"_xswap", wrap_xswap, METH_VARARGS, "Backend for edge permutation"},
+    {"_xswap_networks", wrap_xswap_networks, METH_VARARGS,
+     "Backend for permuting several networks on a shared thread pool"},
+    {"_xswap_occurrence", wrap_xswap_occurrence, METH_VARARGS,
+     "Backend for counting edge occurrences across permutations"},
+    {"_xswap_degree_counts", wrap_xswap_degree_counts, METH_VARARGS,
+     "Backend for counting permuted edges by source and target degree"},
+    {"_xswap_query_counts", wrap_xswap_query_counts, METH_VARARGS,
+     "Backend for counting permuted edges for a set of node pairs"},
+    {"_approximate_degree_pairs", wrap_approximate_degree_pairs, METH_VARARGS,
+     "Backend for the approximate XSwap prior of every degree pair"},
+    {"_scatter_degree_pairs", wrap_scatter_degree_pairs, METH_VARARGS,
+     "Backend for filling node-pair rows from a degree-pair table"},
+    {"_edges_to_compressed", wrap_edges_to_compressed, METH_VARARGS,
+     "Backend for building CSR/CSC index arrays from an edge array"},
+    {"_generate_power_law_edges", wrap_generate_power_law_edges, METH_VARARGS,
+     "Backend for generating power-law networks by the configuration model"},
+    {"_edges_to_packed", wrap_edges_to_packed, METH_VARARGS,
+     "Backend for building a bit-packed dense matrix from an edge array"},
+    {"_load_edge_file", wrap_load_edge_file, METH_VARARGS,
+     "Backend for parsing an integer edge list file into packed edges"},
+    {"_write_edge_file", wrap_write_edge_file, METH_VARARGS,
+     "Backend for writing packed edges as a binary edge file"},
+    {"_xswap_file", wrap_xswap_file, METH_VARARGS,
+     "Backend for permuting a memory-mapped binary edge file"},
+    {"_xswap_write", wrap_xswap_write, METH_VARARGS,
+     "Backend for writing permutations directly to disk"},
+    {"_create_ensemble", wrap_create_ensemble, METH_VARARGS,
+     "Backend for creating a permutation ensemble file"},
+    {"_append_ensemble", wrap_append_ensemble, METH_VARARGS,
+     "Backend for appending encoded permutations to an ensemble file"},
+    {"_open_ensemble", wrap_open_ensemble, METH_VARARGS,
+     "Backend for mapping and indexing an ensemble file"},
+    {"_read_ensemble", wrap_read_ensemble, METH_VARARGS,
+     "Backend for decoding one permutation of an open ensemble file"},
+    {"_map_str_edges", wrap_map_str_edges, METH_VARARGS,
+     "Backend for mapping string node names to sorted integer ids"},
     {NULL, NULL, 0, NULL}
 };
 
@@ -123,6 +1135,14 @@ static struct PyModuleDef xswapmodule = {
     XSwapMethods
 };
 
+/* Engine warnings become Python `RuntimeWarning`s. The engine only warns on
+ the calling thread (see `set_warning_handler`), and calls that release the
+ GIL emit their warnings once they hold it again. */
+static void py_warning_handler(const char *message) {
+    PyErr_WarnEx(PyExc_RuntimeWarning, message, 2);
+}
+
 PyMODINIT_FUNC PyInit__xswap_backend(void) {
+    set_warning_handler(py_warning_handler);
     return PyModule_Create(&xswapmodule);
 }